@@ -0,0 +1,515 @@
+#include <stdio.h>            // fprintf()
+#include <stdlib.h>           // NULL, EXIT_*, strtoul()
+#include <unistd.h>           // getopt() et al., pread(), close()
+#include <string.h>           // strcmp(), strcpy(), strtok_r()
+#include <fcntl.h>            // open()
+#include <math.h>             // pow(), fabs()
+
+#define CANDIES_API static
+#include "candies.h"
+
+#define PROGRAM_NAME "conntrack-proc"
+#define PROGRAM_URL  "https://github.com/domsson/candies/conntrack-proc"
+
+#define PROGRAM_VER_MAJOR 0
+#define PROGRAM_VER_MINOR 1
+#define PROGRAM_VER_PATCH 0
+
+#define DEFAULT_INTERVAL   1
+#define DEFAULT_THRESHOLD  1
+#define DEFAULT_FORMAT    "%u"
+
+#define COUNT_FILE "/proc/sys/net/netfilter/nf_conntrack_count"
+#define MAX_FILE   "/proc/sys/net/netfilter/nf_conntrack_max"
+#define STAT_FILE  "/proc/net/stat/nf_conntrack"
+
+#define STAT_COL_INSERT_FAILED "insert_failed"
+#define STAT_COL_DROP          "drop"
+#define STAT_COL_EARLY_DROP    "early_drop"
+
+#define VALUE_BUFLEN  32
+#define STAT_BUFLEN   65536 // one line per CPU, about 170 bytes each
+
+#define OUTPUT_SIZE 128
+#define RESULT_SIZE 16
+
+typedef unsigned long ulong;
+typedef unsigned char byte;
+
+struct info
+{
+	ulong count;         // current number of entries
+	ulong max;           // maximum number of entries
+	double usage;        // count relative to max, in percent
+	double insert_failed; // failed insertions per second
+	double drop;         // packets dropped per second (table full)
+	double early_drop;   // entries evicted per second to make room
+};
+
+typedef struct info info_s;
+
+// Counters from the stat file, summed up over all CPUs
+struct stats
+{
+	ulong insert_failed;
+	ulong drop;
+	ulong early_drop;
+};
+
+typedef struct stats stats_s;
+
+// Held-open file descriptors and the stat file columns we're interested in
+struct files
+{
+	int count_fd;
+	int max_fd;
+	int stat_fd;
+	int col_insert_failed; // -1 if not available
+	int col_drop;          // -1 if not available
+	int col_early_drop;    // -1 if not available
+};
+
+typedef struct files files_s;
+
+struct options
+{
+	byte monitor : 1;    // keep running and printing
+	byte continuous : 1; // keep printing, regardless of threshold
+	byte unit : 1;       // also print the unit
+	byte space : 1;      // space between val and unit
+	byte help : 1;       // show help and exit
+	byte version : 1;    // show version info and exit
+	int interval;        // print every `interval` seconds
+	int precision;       // decimal places in output
+	double threshold;    // minimum change in usage required to print
+	char *format;        // format string
+};
+
+typedef struct options opts_s;
+
+struct context
+{
+	info_s *info;
+	opts_s *opts;
+	char buffer[RESULT_SIZE];
+	char output[OUTPUT_SIZE];
+};
+
+typedef struct context ctx_s;
+
+static void
+fetch_opts(opts_s *opts, int argc, char **argv)
+{
+	opterr = 0;
+	int o;
+	while ((o = getopt(argc, argv, "f:hi:kmp:st:uV")) != -1)
+	{
+		switch (o)
+		{
+			case 'f':
+				opts->format = optarg;
+				break;
+			case 'h':
+				opts->help = 1;
+				break;
+			case 'i':
+				opts->interval = atoi(optarg);
+				break;
+			case 'k':
+				opts->continuous = 1;
+				break;
+			case 'm':
+				opts->monitor = 1;
+				break;
+			case 'p':
+				opts->precision = atoi(optarg);
+				break;
+			case 's':
+				opts->space = 1;
+				break;
+			case 't':
+				opts->threshold = atof(optarg);
+				break;
+			case 'u':
+				opts->unit = 1;
+				break;
+			case 'V':
+				opts->version = 1;
+				break;
+		}
+	}
+}
+
+/**
+ * Prints usage information.
+ */
+static void
+help(char *invocation, FILE* stream)
+{
+	fprintf(stream, "Usage:\n");
+     	fprintf(stream, "\t%s [OPTIONS...]\n", invocation);
+	fprintf(stream, "\n");
+	fprintf(stream, "Options:\n");
+	fprintf(stream, "\t-f Output format string; default is '%%u'\n");
+	fprintf(stream, "\t-h Print this help text and exit\n");
+	fprintf(stream, "\t-i Seconds between checking for a change in value; default is 1\n");
+	fprintf(stream, "\t-k Keep printing, even if the values haven't changed\n");
+	fprintf(stream, "\t-m Keep running and print when there is a notable change in value\n");
+	fprintf(stream, "\t-p Number of decimal digits in the output; default is 0\n");
+	fprintf(stream, "\t-s Print a space between value and unit\n");
+	fprintf(stream, "\t-t Required change in usage in order to print again; default is 1\n");
+	fprintf(stream, "\t-u Print the appropriate unit after the value\n");
+	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "Format specifiers:\n");
+	fprintf(stream, "\t%%u: Table usage (percent)\n");
+	fprintf(stream, "\t%%c: Number of entries in the table\n");
+	fprintf(stream, "\t%%m: Maximum number of entries in the table\n");
+	fprintf(stream, "\t%%f: Failed insertions per second\n");
+	fprintf(stream, "\t%%d: Dropped packets per second\n");
+	fprintf(stream, "\t%%e: Early drops (evictions) per second\n");
+}
+
+/*
+ * Print version information.
+ */
+static void
+version(FILE *stream)
+{
+	fprintf(stream, "%s %d.%d.%d\n%s\n", PROGRAM_NAME,
+			PROGRAM_VER_MAJOR, PROGRAM_VER_MINOR, PROGRAM_VER_PATCH,
+			PROGRAM_URL);
+}
+
+/*
+ * Reads the entire contents of the given (held-open) file into `buf`, which
+ * will be null-terminated. Returns the number of bytes read or -1 on error.
+ */
+static ssize_t
+read_fd(int fd, char *buf, size_t len)
+{
+	size_t total = 0;
+	ssize_t num = 0;
+
+	while (total < len - 1 && (num = pread(fd, buf + total, len - 1 - total, total)) > 0)
+	{
+		total += num;
+	}
+
+	buf[total] = '\0';
+	return num == -1 ? -1 : (ssize_t) total;
+}
+
+/*
+ * Reads a single numeric value from the given (held-open) file.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+read_fd_to_var(int fd, ulong *value)
+{
+	char buf[VALUE_BUFLEN];
+	if (read_fd(fd, buf, VALUE_BUFLEN) <= 0)
+	{
+		return -1;
+	}
+
+	*value = strtoul(buf, NULL, 10);
+	return 0;
+}
+
+/*
+ * Opens all files we need and figures out which columns of the stat file
+ * hold the counters we're interested in, as these differ between kernel
+ * versions. Returns 0 on success, -1 on error.
+ */
+static int
+open_files(files_s *files)
+{
+	files->count_fd = open(COUNT_FILE, O_RDONLY | O_CLOEXEC);
+	files->max_fd   = open(MAX_FILE,   O_RDONLY | O_CLOEXEC);
+	files->stat_fd  = open(STAT_FILE,  O_RDONLY | O_CLOEXEC);
+
+	if (files->count_fd == -1 || files->max_fd == -1 || files->stat_fd == -1)
+	{
+		return -1;
+	}
+
+	char buf[STAT_BUFLEN];
+	if (read_fd(files->stat_fd, buf, STAT_BUFLEN) <= 0)
+	{
+		return -1;
+	}
+
+	files->col_insert_failed = -1;
+	files->col_drop          = -1;
+	files->col_early_drop    = -1;
+
+	// the first line holds the column names
+	buf[strcspn(buf, "\n")] = '\0';
+
+	char *save = NULL;
+	char *token = NULL;
+	int i;
+	for (i = 0; (token = strtok_r(i == 0 ? buf : NULL, " ", &save)); ++i)
+	{
+		if (strcmp(token, STAT_COL_INSERT_FAILED) == 0)
+		{
+			files->col_insert_failed = i;
+		}
+		else if (strcmp(token, STAT_COL_DROP) == 0)
+		{
+			files->col_drop = i;
+		}
+		else if (strcmp(token, STAT_COL_EARLY_DROP) == 0)
+		{
+			files->col_early_drop = i;
+		}
+	}
+
+	return 0;
+}
+
+static void
+close_files(files_s *files)
+{
+	if (files->count_fd != -1) close(files->count_fd);
+	if (files->max_fd   != -1) close(files->max_fd);
+	if (files->stat_fd  != -1) close(files->stat_fd);
+}
+
+/*
+ * Reads the stat file, which has one line of (hexadecimal) counters per CPU,
+ * and sums up the counters we're interested in. Returns 0 on success, -1 on
+ * error.
+ */
+static int
+read_stats(files_s *files, stats_s *stats)
+{
+	char buf[STAT_BUFLEN];
+	if (read_fd(files->stat_fd, buf, STAT_BUFLEN) <= 0)
+	{
+		return -1;
+	}
+
+	*stats = (const stats_s) { 0 };
+
+	// skip the header line
+	char *line = strchr(buf, '\n');
+
+	for (; line && *++line; line = strchr(line, '\n'))
+	{
+		char *curr = line;
+		char *next = NULL;
+		int i;
+		for (i = 0; *curr && *curr != '\n'; ++i, curr = next)
+		{
+			ulong val = strtoul(curr, &next, 16);
+			if (next == curr)
+			{
+				break;
+			}
+
+			if (i == files->col_insert_failed)
+			{
+				stats->insert_failed += val;
+			}
+			else if (i == files->col_drop)
+			{
+				stats->drop += val;
+			}
+			else if (i == files->col_early_drop)
+			{
+				stats->early_drop += val;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int
+fetch_info(files_s *files, opts_s *opts, info_s *info, stats_s *prev)
+{
+	if (read_fd_to_var(files->count_fd, &info->count) == -1)
+	{
+		return -1;
+	}
+	if (read_fd_to_var(files->max_fd, &info->max) == -1)
+	{
+		return -1;
+	}
+
+	stats_s curr = { 0 };
+	if (read_stats(files, &curr) == -1)
+	{
+		return -1;
+	}
+
+	info->usage = info->max ? ((double) info->count / (double) info->max) * 100.0 : 0.0;
+
+	info->insert_failed = (curr.insert_failed - prev->insert_failed) / (double) opts->interval;
+	info->drop          = (curr.drop          - prev->drop)          / (double) opts->interval;
+	info->early_drop    = (curr.early_drop    - prev->early_drop)    / (double) opts->interval;
+
+	*prev = curr;
+	return 0;
+}
+
+static void
+format_rel_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? "%" : ""
+	);
+}
+
+static void
+format_rate_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? "/s" : ""
+	);
+}
+
+static char*
+candy_format_cb(char c, void* context)
+{
+	ctx_s* ctx = (ctx_s*) context;
+
+	switch (c)
+	{
+		case 'u': // usage, relative
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->usage, ctx->opts);
+			return ctx->buffer;
+		case 'c': // count
+			snprintf(ctx->buffer, RESULT_SIZE, "%lu", ctx->info->count);
+			return ctx->buffer;
+		case 'm': // max
+			snprintf(ctx->buffer, RESULT_SIZE, "%lu", ctx->info->max);
+			return ctx->buffer;
+		case 'f': // failed insertions per second
+			format_rate_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->insert_failed, ctx->opts);
+			return ctx->buffer;
+		case 'd': // drops per second
+			format_rate_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->drop, ctx->opts);
+			return ctx->buffer;
+		case 'e': // early drops per second
+			format_rate_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->early_drop, ctx->opts);
+			return ctx->buffer;
+		default:
+			return NULL;
+	}
+}
+
+static void
+format_info(ctx_s* ctx)
+{
+	candy_format(ctx->opts->format, ctx->output, OUTPUT_SIZE, candy_format_cb, ctx);
+}
+
+/*
+ * Checks whether the value changed enough for us to print. Any change in one
+ * of the failure rates is always considered notable, as those mean that
+ * connections are being affected by the table running full.
+ */
+static int
+is_notable(info_s *curr, info_s *prev, double threshold)
+{
+	return fabs(curr->usage - prev->usage) >= threshold ||
+		curr->insert_failed != prev->insert_failed ||
+		curr->drop          != prev->drop          ||
+		curr->early_drop    != prev->early_drop;
+}
+
+int
+main(int argc, char **argv)
+{
+	opts_s opts = { .threshold = -1 };
+	fetch_opts(&opts, argc, argv);
+
+	if (opts.help)
+	{
+		help(argv[0], stdout);
+		return EXIT_SUCCESS;
+	}
+
+	if (opts.version)
+	{
+		version(stdout);
+		return EXIT_SUCCESS;
+	}
+
+	if (opts.threshold == -1)
+	{
+		opts.threshold = DEFAULT_THRESHOLD / pow(10.0, (double) opts.precision);
+	}
+
+	if (opts.interval == 0)
+	{
+		// We need some interval, as we need to take two measurements
+		opts.interval = DEFAULT_INTERVAL;
+	}
+
+	// if not format given, use the default
+	if (opts.format == NULL)
+	{
+		opts.format = DEFAULT_FORMAT;
+	}
+
+	// all files are opened once and then re-read on every iteration
+	files_s files = { .count_fd = -1, .max_fd = -1, .stat_fd = -1 };
+	if (open_files(&files) == -1)
+	{
+		close_files(&files);
+		return EXIT_FAILURE;
+	}
+
+	// make sure stdout is line buffered
+	setlinebuf(stdout);
+
+	// data structures we'll need from here on out
+	info_s info = { 0 };
+	info_s info_prev = { .usage = -1.0 }; // makes sure that we print the first time
+	stats_s stats = { 0 };
+	ctx_s ctx = { .info = &info, .opts = &opts };
+
+	// initial read of the counters, so we can calculate rates
+	if (read_stats(&files, &stats) == -1)
+	{
+		close_files(&files);
+		return EXIT_FAILURE;
+	}
+
+	do
+	{
+		sleep(opts.interval);
+
+		if (fetch_info(&files, &opts, &info, &stats) == -1)
+		{
+			close_files(&files);
+			return EXIT_FAILURE;
+		}
+
+		if (opts.continuous || is_notable(&info, &info_prev, opts.threshold))
+		{
+			format_info(&ctx);
+			fprintf(stdout, "%s\n", ctx.output);
+
+			info_prev = info;
+		}
+	}
+	while (opts.monitor);
+
+	close_files(&files);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,1038 @@
+#include <stdio.h>            // fprintf
+#include <stdlib.h>           // NULL, EXIT_*
+#include <stdint.h>           // uint64_t, int64_t
+#include <unistd.h>           // getopt() et al., syscall(), close()
+#include <ctype.h>            // tolower()
+#include <string.h>           // strlen(), strcpy(), strcmp()
+#include <fcntl.h>            // openat(), AT_*
+#include <dirent.h>           // DT_DIR, DT_UNKNOWN
+#include <time.h>             // clock_gettime()
+#include <pthread.h>          // pthread_create() et al.
+#include <sys/stat.h>         // fstat(), fstatat()
+#include <sys/syscall.h>      // SYS_getdents64
+
+#define CANDIES_API static
+#include "candies.h"
+
+#define PROGRAM_NAME "dir-getdents"
+#define PROGRAM_URL  "https://github.com/domsson/candies/dir-getdents"
+
+#define PROGRAM_VER_MAJOR 0
+#define PROGRAM_VER_MINOR 1
+#define PROGRAM_VER_PATCH 0
+
+#define DEFAULT_PATH        "."
+#define DEFAULT_INTERVAL     60
+#define DEFAULT_THREADS      4
+#define DEFAULT_RESCAN       10
+#define DEFAULT_GRANULARITY "m"
+#define DEFAULT_FORMAT      "%S"
+#define DEFAULT_SEPARATOR   " "
+
+#define DENTS_BUFLEN 32768
+#define CACHE_SIZE   1024    // initial number of buckets, power of two
+#define BLOCK_SIZE   512     // st_blocks always counts 512 byte blocks
+
+#define OUTPUT_SIZE 128
+#define RESULT_SIZE 24
+
+typedef unsigned long ulong;
+typedef unsigned char byte;
+
+// Directory entry as returned by getdents64(), see getdents(2)
+struct linux_dirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+struct count
+{
+	ulong disk;          // bytes allocated on disk (like `du`)
+	ulong size;          // apparent size in bytes (like `du -b`)
+	ulong files;         // number of non-directory entries
+	ulong dirs;          // number of directories
+};
+
+typedef struct count count_s;
+
+// Cache entry for one directory. It holds what was found in the directory
+// itself (not in its subdirectories), which stays valid as long as the mtime
+// of the directory doesn't change, as well as the names of its subdirectories,
+// so these can be checked without reading the directory again.
+struct node
+{
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+	count_s own;         // the directory itself and its non-directory entries
+	char *subdirs;       // names of the subdirectories, each null-terminated
+	size_t num_subdirs;  // number of names in `subdirs`
+	ulong round;         // round of scans the node was last seen in
+	ulong scan;          // scan the node was last seen in
+	struct node *next;   // next node in the same bucket
+};
+
+typedef struct node node_s;
+
+struct cache
+{
+	node_s **buckets;
+	size_t size;         // number of buckets
+	size_t num;          // number of nodes
+};
+
+typedef struct cache cache_s;
+
+// Open directory that serves as the base for openat() of its subdirectories;
+// closed once the last of them has been opened
+struct dirref
+{
+	int fd;
+	size_t refs;
+};
+
+typedef struct dirref dirref_s;
+
+struct task
+{
+	dirref_s *parent;    // NULL for the top directory
+	char *name;          // relative to `parent`
+};
+
+typedef struct task task_s;
+
+// Everything shared by the main thread and the workers, guarded by `lock`
+struct pool
+{
+	pthread_mutex_t lock;
+	pthread_cond_t work;     // signalled when tasks have been added
+	pthread_cond_t idle;     // signalled when the last task has been done
+	pthread_t *threads;
+	size_t num_threads;
+	task_s *tasks;           // stack of directories to be scanned
+	size_t num_tasks;
+	size_t cap_tasks;
+	size_t pending;          // tasks waiting or in progress
+	cache_s cache;
+	count_s total;           // result of the current scan
+	dev_t dev;               // device of the top directory
+	ulong round;             // incremented for every round of scans
+	ulong scan;              // incremented for every scan
+	byte one_fs : 1;         // don't descend into other filesystems
+	byte full : 1;           // ignore the cache for this round
+	byte quit : 1;           // workers should exit
+	byte failed : 1;         // the top directory couldn't be opened
+};
+
+typedef struct pool pool_s;
+
+struct dir
+{
+	char *path;
+	count_s count;
+	double millis;       // duration of the last scan
+	char output_prev[OUTPUT_SIZE];
+	char output_curr[OUTPUT_SIZE];
+};
+
+typedef struct dir dir_s;
+
+struct opts
+{
+	byte help : 1;       // show help and exit
+	byte version : 1;    // show version info and exit
+	byte monitor : 1;    // keep running and printing
+	byte unit : 1;       // print a unit character
+	byte space : 1;      // print a space between value and unit
+	byte binary : 1;     // binary instead of decimal units (MiB vs MB etc)
+	byte continuous : 1; // continously print, even if no change in value
+	byte records : 1;    // print one line per directory instead of joining them
+	byte one_fs : 1;     // stay on the filesystem of the given directory
+	int interval;        // interval, in seconds, between scans
+	int precision;       // number of decimals in output
+	int threads;         // number of worker threads
+	int rescan;          // ignore the cache every this many scans
+	char **paths;        // directories of interest
+	size_t num_paths;    // number of elements in `paths`
+	char *separator;     // separator between directories (if not `records`)
+	char *format;
+	char granularity;    // unit granularity (m = mega, g = giga, etc)
+
+	ulong unit_size;     // will be set by program
+	char *unit_abbr;     // will be set by program
+};
+
+typedef struct opts opts_s;
+
+struct context
+{
+	opts_s* opts;
+	dir_s* dir;
+	char buffer[RESULT_SIZE];
+};
+
+typedef struct context ctx_s;
+
+static void
+fetch_opts(opts_s *opts, int argc, char **argv)
+{
+	// there can't be more paths than arguments
+	opts->paths = calloc(argc, sizeof(char*));
+
+	opterr = 0;
+	int o;
+	while ((o = getopt(argc, argv, "bd:f:g:hi:j:kmp:R:rS:suVx")) != -1)
+	{
+		switch (o)
+		{
+			case 'b':
+				opts->binary = 1;
+				break;
+			case 'd':
+				opts->paths[opts->num_paths++] = optarg;
+				break;
+			case 'f':
+				opts->format = optarg;
+				break;
+			case 'g':
+				opts->granularity = tolower(optarg[0]);
+				break;
+			case 'h':
+				opts->help = 1;
+				break;
+			case 'i':
+				opts->interval = atoi(optarg);
+				break;
+			case 'j':
+				opts->threads = atoi(optarg);
+				break;
+			case 'k':
+				opts->continuous = 1;
+				break;
+			case 'm':
+				opts->monitor = 1;
+				break;
+			case 'p':
+				opts->precision = atoi(optarg);
+				break;
+			case 'R':
+				opts->rescan = atoi(optarg);
+				break;
+			case 'r':
+				opts->records = 1;
+				break;
+			case 'S':
+				opts->separator = optarg;
+				break;
+			case 's':
+				opts->space = 1;
+				break;
+			case 'u':
+				opts->unit = 1;
+				break;
+			case 'V':
+				opts->version = 1;
+				break;
+			case 'x':
+				opts->one_fs = 1;
+				break;
+		}
+	}
+}
+
+static void
+help(char *invocation, FILE* stream)
+{
+	fprintf(stream, "Usage:\n");
+	fprintf(stream, "\t%s [OPTION...]\n", invocation);
+	fprintf(stream, "\n");
+	fprintf(stream, "Options:\n");
+	fprintf(stream, "\t-b Use binary instead of decimal units\n");
+	fprintf(stream, "\t-d DIR Directory to get the size of, can be repeated; default is '.'\n");
+	fprintf(stream, "\t-f FORMAT Format string for output, default is '%%S'\n");
+	fprintf(stream, "\t-g GRANULARITY Value granularity (k, m, g, t, p); default is 'm'\n");
+	fprintf(stream, "\t-h Print this help text and exit\n");
+	fprintf(stream, "\t-i INTERVAL Seconds between scans; default is 60\n");
+	fprintf(stream, "\t-j THREADS Number of threads scanning directories; default is 4\n");
+	fprintf(stream, "\t-k Keep printing even if the output hasn't changed\n");
+	fprintf(stream, "\t-m Keep running and print when there is a change in output\n");
+	fprintf(stream, "\t-p Number of decimal digits in the output; default is 0\n");
+	fprintf(stream, "\t-R RESCAN Ignore the cache every RESCAN scans, 0 for never; default is 10\n");
+	fprintf(stream, "\t-r Print one line per directory instead of joining them\n");
+	fprintf(stream, "\t-S SEPARATOR String to put between directories (without -r); default is ' '\n");
+	fprintf(stream, "\t-s Print a space between value and unit\n");
+	fprintf(stream, "\t-u Print the appropriate unit after the value\n");
+	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\t-x Don't descend into directories on other filesystems\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "Format specifiers:\n");
+	fprintf(stream, "\t%%S: Disk space used (like du)\n");
+	fprintf(stream, "\t%%A: Apparent size (like du -b)\n");
+	fprintf(stream, "\t%%F: Number of files (everything but directories)\n");
+	fprintf(stream, "\t%%D: Number of directories (including the given one)\n");
+	fprintf(stream, "\t%%t: Duration of the last scan (ms)\n");
+	fprintf(stream, "\t%%n: Directory, as given\n");
+}
+
+/*
+ * Print version information.
+ */
+static void
+version(FILE *stream)
+{
+	fprintf(stream, "%s %d.%d.%d\n%s\n", PROGRAM_NAME,
+			PROGRAM_VER_MAJOR, PROGRAM_VER_MINOR, PROGRAM_VER_PATCH,
+			PROGRAM_URL);
+}
+
+static double
+get_time()
+{
+	struct timespec ts = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+static void
+count_add(count_s *to, const count_s *from)
+{
+	to->disk  += from->disk;
+	to->size  += from->size;
+	to->files += from->files;
+	to->dirs  += from->dirs;
+}
+
+static size_t
+cache_hash(dev_t dev, ino_t ino)
+{
+	uint64_t h = ((uint64_t) dev * 31) ^ (uint64_t) ino;
+	return (size_t) (h * 0x9E3779B97F4A7C15ULL >> 16);
+}
+
+static node_s*
+cache_find(cache_s *cache, dev_t dev, ino_t ino)
+{
+	node_s *node = cache->buckets[cache_hash(dev, ino) & (cache->size - 1)];
+	while (node && (node->dev != dev || node->ino != ino))
+	{
+		node = node->next;
+	}
+	return node;
+}
+
+/*
+ * Doubles the number of buckets. Returns 0 on success, -1 on error.
+ */
+static int
+cache_grow(cache_s *cache)
+{
+	size_t size = cache->size * 2;
+	node_s **buckets = calloc(size, sizeof(node_s*));
+	if (buckets == NULL)
+	{
+		return -1;
+	}
+
+	for (size_t i = 0; i < cache->size; ++i)
+	{
+		node_s *node = cache->buckets[i];
+		while (node)
+		{
+			node_s *next = node->next;
+			size_t b = cache_hash(node->dev, node->ino) & (size - 1);
+			node->next = buckets[b];
+			buckets[b] = node;
+			node = next;
+		}
+	}
+
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->size = size;
+	return 0;
+}
+
+/*
+ * Adds a new (empty) node for the given directory.
+ * Returns the node on success, NULL on error.
+ */
+static node_s*
+cache_add(cache_s *cache, dev_t dev, ino_t ino)
+{
+	if (cache->num >= cache->size && cache_grow(cache) == -1)
+	{
+		return NULL;
+	}
+
+	node_s *node = calloc(1, sizeof(node_s));
+	if (node == NULL)
+	{
+		return NULL;
+	}
+	node->dev = dev;
+	node->ino = ino;
+
+	size_t b = cache_hash(dev, ino) & (cache->size - 1);
+	node->next = cache->buckets[b];
+	cache->buckets[b] = node;
+	++cache->num;
+	return node;
+}
+
+/*
+ * Removes all nodes that haven't been seen in the given round of scans, which
+ * are those of directories that have been deleted, renamed or moved away.
+ */
+static void
+cache_sweep(cache_s *cache, ulong round)
+{
+	for (size_t i = 0; i < cache->size; ++i)
+	{
+		node_s **link = &cache->buckets[i];
+		while (*link)
+		{
+			node_s *node = *link;
+			if (node->round == round)
+			{
+				link = &node->next;
+				continue;
+			}
+			*link = node->next;
+			free(node->subdirs);
+			free(node);
+			--cache->num;
+		}
+	}
+}
+
+static void
+cache_free(cache_s *cache)
+{
+	cache_sweep(cache, 0);
+	free(cache->buckets);
+	cache->buckets = NULL;
+}
+
+static void
+dirref_release(dirref_s *ref)
+{
+	if (ref && --ref->refs == 0)
+	{
+		close(ref->fd);
+		free(ref);
+	}
+}
+
+/*
+ * Makes sure there is room for `num` more tasks. Must be called with the 
+ * pool's lock held. Returns 0 on success, -1 on error.
+ */
+static int
+reserve_tasks(pool_s *pool, size_t num)
+{
+	if (pool->num_tasks + num <= pool->cap_tasks)
+	{
+		return 0;
+	}
+
+	size_t cap = (pool->num_tasks + num) * 2;
+	task_s *tasks = realloc(pool->tasks, cap * sizeof(task_s));
+	if (tasks == NULL)
+	{
+		return -1;
+	}
+	pool->tasks = tasks;
+	pool->cap_tasks = cap;
+	return 0;
+}
+
+/*
+ * Pushes one task per subdirectory, all of which will be opened relative to
+ * `fd`. If there are no subdirectories, `fd` is closed right away. Must be
+ * called with the pool's lock held. Returns 0 on success, -1 on error.
+ */
+static int
+push_subdirs(pool_s *pool, int fd, const char *subdirs, size_t num_subdirs)
+{
+	if (num_subdirs == 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	if (reserve_tasks(pool, num_subdirs) == -1)
+	{
+		close(fd);
+		return -1;
+	}
+
+	dirref_s *ref = malloc(sizeof(dirref_s));
+	if (ref == NULL)
+	{
+		close(fd);
+		return -1;
+	}
+	ref->fd = fd;
+	ref->refs = num_subdirs;
+
+	const char *name = subdirs;
+	for (size_t i = 0; i < num_subdirs; ++i)
+	{
+		pool->tasks[pool->num_tasks++] = (task_s) { ref, strdup(name) };
+		name += strlen(name) + 1;
+	}
+
+	pool->pending += num_subdirs;
+	pthread_cond_broadcast(&pool->work);
+	return 0;
+}
+
+/*
+ * Reads all entries of the directory, adding up the sizes of all but the
+ * subdirectories, whose names get collected in `subdirs` instead.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+read_dir(int fd, count_s *own, char **subdirs, size_t *num_subdirs)
+{
+	char buf[DENTS_BUFLEN];
+	size_t len = 0;
+	size_t cap = 0;
+	long n;
+
+	while ((n = syscall(SYS_getdents64, fd, buf, DENTS_BUFLEN)) > 0)
+	{
+		for (long off = 0; off < n; )
+		{
+			struct linux_dirent64 *entry = (struct linux_dirent64 *) (buf + off);
+			off += entry->d_reclen;
+
+			const char *name = entry->d_name;
+			if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+			{
+				continue;
+			}
+
+			struct stat st = { 0 };
+			int is_dir = entry->d_type == DT_DIR;
+
+			// some filesystems don't fill in d_type
+			if (entry->d_type == DT_UNKNOWN || !is_dir)
+			{
+				if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+				{
+					continue;
+				}
+				is_dir = S_ISDIR(st.st_mode);
+			}
+
+			if (!is_dir)
+			{
+				own->disk += st.st_blocks * BLOCK_SIZE;
+				own->size += st.st_size;
+				own->files += 1;
+				continue;
+			}
+
+			size_t name_len = strlen(name) + 1;
+			if (len + name_len > cap)
+			{
+				cap = (len + name_len) * 2;
+				char *grown = realloc(*subdirs, cap);
+				if (grown == NULL)
+				{
+					return -1;
+				}
+				*subdirs = grown;
+			}
+			memcpy(*subdirs + len, name, name_len);
+			len += name_len;
+			*num_subdirs += 1;
+		}
+	}
+
+	return n == -1 ? -1 : 0;
+}
+
+/*
+ * Scans one directory. If it is in the cache and its mtime hasn't changed,
+ * the cached values are used and the directory isn't read at all. Either way,
+ * its subdirectories are then pushed as new tasks, so that they get checked.
+ */
+static void
+do_task(pool_s *pool, task_s *task)
+{
+	// symlinks are only followed for the top directory, as given by the user
+	int top  = task->parent == NULL;
+	int base = top ? AT_FDCWD : task->parent->fd;
+	int fd = openat(base, task->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | (top ? 0 : O_NOFOLLOW));
+
+	pthread_mutex_lock(&pool->lock);
+	dirref_release(task->parent);
+	pthread_mutex_unlock(&pool->lock);
+	free(task->name);
+
+	struct stat st = { 0 };
+	if (fd == -1 || fstat(fd, &st) == -1 || (pool->one_fs && st.st_dev != pool->dev))
+	{
+		if (fd != -1)
+		{
+			close(fd);
+		}
+		if (top)
+		{
+			pthread_mutex_lock(&pool->lock);
+			pool->failed = 1;
+			pthread_mutex_unlock(&pool->lock);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	node_s *node = cache_find(&pool->cache, st.st_dev, st.st_ino);
+
+	// seen before in this scan (bind mounts), don't count it twice
+	if (node && node->scan == pool->scan)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		close(fd);
+		return;
+	}
+
+	// unchanged since the last scan, only its subdirectories need checking
+	if (node && !pool->full &&
+			node->mtime.tv_sec  == st.st_mtim.tv_sec &&
+			node->mtime.tv_nsec == st.st_mtim.tv_nsec)
+	{
+		node->round = pool->round;
+		node->scan  = pool->scan;
+		count_add(&pool->total, &node->own);
+		push_subdirs(pool, fd, node->subdirs, node->num_subdirs);
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	count_s own = { .disk = st.st_blocks * BLOCK_SIZE, .size = st.st_size, .dirs = 1 };
+	char *subdirs = NULL;
+	size_t num_subdirs = 0;
+	if (read_dir(fd, &own, &subdirs, &num_subdirs) == -1)
+	{
+		// count what we've got, but don't cache it
+		st.st_mtim.tv_sec = st.st_mtim.tv_nsec = -1;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	node = cache_find(&pool->cache, st.st_dev, st.st_ino);
+	if (node == NULL)
+	{
+		node = cache_add(&pool->cache, st.st_dev, st.st_ino);
+	}
+	if (node == NULL || node->scan == pool->scan)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		free(subdirs);
+		close(fd);
+		return;
+	}
+	free(node->subdirs);
+	node->mtime       = st.st_mtim;
+	node->own         = own;
+	node->subdirs     = subdirs;
+	node->num_subdirs = num_subdirs;
+	node->round       = pool->round;
+	node->scan        = pool->scan;
+	count_add(&pool->total, &own);
+	push_subdirs(pool, fd, subdirs, num_subdirs);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void*
+worker_main(void *arg)
+{
+	pool_s *pool = arg;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1)
+	{
+		while (pool->num_tasks == 0 && !pool->quit)
+		{
+			pthread_cond_wait(&pool->work, &pool->lock);
+		}
+		if (pool->quit)
+		{
+			break;
+		}
+
+		// last in, first out, which keeps the number of open directories low
+		task_s task = pool->tasks[--pool->num_tasks];
+		pthread_mutex_unlock(&pool->lock);
+
+		do_task(pool, &task);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->pending == 0)
+		{
+			pthread_cond_signal(&pool->idle);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/*
+ * Sets up the cache and starts the worker threads.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+pool_init(pool_s *pool, opts_s *opts)
+{
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+	pool->one_fs = opts->one_fs;
+
+	pool->cache.size = CACHE_SIZE;
+	pool->cache.buckets = calloc(CACHE_SIZE, sizeof(node_s*));
+	pool->threads = calloc(opts->threads, sizeof(pthread_t));
+	if (pool->cache.buckets == NULL || pool->threads == NULL)
+	{
+		return -1;
+	}
+
+	for (int i = 0; i < opts->threads; ++i)
+	{
+		if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0)
+		{
+			return -1;
+		}
+		++pool->num_threads;
+	}
+	return 0;
+}
+
+static void
+pool_free(pool_s *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (size_t i = 0; i < pool->num_threads; ++i)
+	{
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	cache_free(&pool->cache);
+	free(pool->threads);
+	free(pool->tasks);
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/*
+ * Scans the given directory (and everything below it) using the workers and
+ * waits for them to finish. Returns 0 on success, -1 on error.
+ */
+static int
+fetch_info(pool_s *pool, dir_s *dir)
+{
+	struct stat st = { 0 };
+	if (stat(dir->path, &st) == -1 || !S_ISDIR(st.st_mode))
+	{
+		return -1;
+	}
+
+	double start = get_time();
+
+	pthread_mutex_lock(&pool->lock);
+	if (reserve_tasks(pool, 1) == -1)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		return -1;
+	}
+	pool->dev    = st.st_dev;
+	pool->total  = (const count_s) { 0 };
+	pool->failed = 0;
+	++pool->scan;
+
+	pool->tasks[pool->num_tasks++] = (task_s) { NULL, strdup(dir->path) };
+	pool->pending = 1;
+	pthread_cond_signal(&pool->work);
+
+	while (pool->pending)
+	{
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	}
+	dir->count = pool->total;
+	int failed = pool->failed;
+	pthread_mutex_unlock(&pool->lock);
+
+	if (failed)
+	{
+		return -1;
+	}
+
+	dir->millis = (get_time() - start) * 1000.0;
+	return 0;
+}
+
+static void
+format_abs_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val / opts->unit_size,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? opts->unit_abbr : ""
+	);
+}
+
+static void
+format_cnt_value(char *buf, size_t len, ulong val)
+{
+	snprintf(buf, len, "%lu", val);
+}
+
+static void
+format_value(char *buf, size_t len, double val, const char *unit, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? unit : ""
+	);
+}
+
+static char*
+candy_format_cb(char c, void* context)
+{
+	ctx_s* ctx = (ctx_s*) context;
+
+	switch(c)
+	{
+		case 'S':       // disk space used
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->dir->count.disk, ctx->opts);
+			return ctx->buffer;
+		case 'A':       // apparent size
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->dir->count.size, ctx->opts);
+			return ctx->buffer;
+		case 'F':       // number of files
+			format_cnt_value(ctx->buffer, RESULT_SIZE,
+					ctx->dir->count.files);
+			return ctx->buffer;
+		case 'D':       // number of directories
+			format_cnt_value(ctx->buffer, RESULT_SIZE,
+					ctx->dir->count.dirs);
+			return ctx->buffer;
+		case 't':       // scan duration
+			format_value(ctx->buffer, RESULT_SIZE,
+					ctx->dir->millis, "ms", ctx->opts);
+			return ctx->buffer;
+		case 'n':       // directory
+			return ctx->dir->path;
+		default:
+			return NULL;
+	}
+}
+
+static void
+format_info(ctx_s* ctx, dir_s* dir)
+{
+	ctx->dir = dir;
+	candy_format(ctx->opts->format, dir->output_curr, OUTPUT_SIZE, candy_format_cb, ctx);
+}
+
+/*
+ * Prints the output of all directories, either joined into one line or one
+ * line per directory. In the latter case, only directories with changed
+ * output are printed, unless `all` is set.
+ */
+static void
+print_dirs(dir_s* dirs, size_t num, opts_s* opts, int all)
+{
+	for (size_t i = 0; i < num; ++i)
+	{
+		dir_s *dir = &dirs[i];
+		if (opts->records && !all && strcmp(dir->output_prev, dir->output_curr) == 0)
+		{
+			continue;
+		}
+		if (opts->records)
+		{
+			fprintf(stdout, "%s\n", dir->output_curr);
+		}
+		else
+		{
+			fprintf(stdout, "%s%s", i ? opts->separator : "", dir->output_curr);
+		}
+	}
+
+	if (!opts->records)
+	{
+		fprintf(stdout, "\n");
+	}
+}
+
+/*
+ * Checks if the output of any of the directories has changed.
+ */
+static int
+output_changed(dir_s* dirs, size_t num)
+{
+	for (size_t i = 0; i < num; ++i)
+	{
+		if (strcmp(dirs[i].output_prev, dirs[i].output_curr) != 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	opts_s opts = { .rescan = -1 };
+	fetch_opts(&opts, argc, argv);
+
+	// show help and exit
+	if (opts.help)
+	{
+		help(argv[0], stdout);
+		free(opts.paths);
+		return EXIT_SUCCESS;
+	}
+
+	// show version info and exit
+	if (opts.version)
+	{
+		version(stdout);
+		free(opts.paths);
+		return EXIT_SUCCESS;
+	}
+
+	if (opts.num_paths == 0)
+	{
+		opts.paths[opts.num_paths++] = DEFAULT_PATH;
+	}
+
+	if (opts.format == NULL)
+	{
+		opts.format = DEFAULT_FORMAT;
+	}
+
+	if (opts.separator == NULL)
+	{
+		opts.separator = DEFAULT_SEPARATOR;
+	}
+
+	if (opts.granularity == 0)
+	{
+		opts.granularity = *DEFAULT_GRANULARITY;
+	}
+
+	// if no number of threads given, use the default
+	if (opts.threads <= 0)
+	{
+		opts.threads = DEFAULT_THREADS;
+	}
+
+	// if no rescan given, use the default (0 would mean never)
+	if (opts.rescan < 0)
+	{
+		opts.rescan = DEFAULT_RESCAN;
+	}
+
+	// if no interval given, use the default
+	if (opts.interval == 0)
+	{
+		opts.interval = DEFAULT_INTERVAL;
+	}
+
+	// set interval to 0 if we don't monitor (run only once)
+	if (opts.monitor == 0)
+	{
+		opts.interval = 0;
+	}
+
+	// ensure stdout is line buffered
+	setlinebuf(stdout);
+
+	// set additional members of the opts struct based on the granularity
+	candy_unit_info(opts.granularity, opts.binary, &opts.unit_size, &opts.unit_abbr);
+
+	// important data structures for processing
+	dir_s *dirs = calloc(opts.num_paths, sizeof(dir_s));
+	pool_s pool = { 0 };
+	ctx_s ctx = { .opts = &opts };
+	int status = EXIT_SUCCESS;
+
+	if (dirs == NULL || pool_init(&pool, &opts) == -1)
+	{
+		pool_free(&pool);
+		free(dirs);
+		free(opts.paths);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < opts.num_paths; ++i)
+	{
+		dirs[i].path = opts.paths[i];
+	}
+
+	do
+	{
+		// the first round, and every `rescan` rounds, ignore the cache
+		pool.full = opts.rescan ? pool.round % opts.rescan == 0 : pool.round == 0;
+		++pool.round;
+
+		for (size_t i = 0; i < opts.num_paths; ++i)
+		{
+			// scan the directory and formulate the output string
+			if (fetch_info(&pool, &dirs[i]) == -1)
+			{
+				status = EXIT_FAILURE;
+				break;
+			}
+			format_info(&ctx, &dirs[i]);
+		}
+		if (status == EXIT_FAILURE)
+		{
+			break;
+		}
+
+		// forget about directories that are gone
+		cache_sweep(&pool.cache, pool.round);
+
+		// print
+		if (opts.continuous || output_changed(dirs, opts.num_paths))
+		{
+			print_dirs(dirs, opts.num_paths, &opts, opts.continuous);
+		}
+
+		// update values for next iteration
+		for (size_t i = 0; i < opts.num_paths; ++i)
+		{
+			strcpy(dirs[i].output_prev, dirs[i].output_curr);
+		}
+
+		// sleep, maybe (if interval > 0)
+		sleep(opts.interval);
+	}
+	while (opts.monitor);
+
+	pool_free(&pool);
+	free(dirs);
+	free(opts.paths);
+	return status;
+}
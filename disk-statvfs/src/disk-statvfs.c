@@ -3,6 +3,12 @@
 #include <unistd.h>           // getopt() et al.
 #include <ctype.h>            // tolower()
 #include <string.h>           // strstr(), strcpy(), strcmp()
+#include <limits.h>           // PATH_MAX
+#include <fcntl.h>            // open()
+#include <poll.h>             // poll()
+#include <time.h>             // clock_gettime()
+#include <errno.h>            // ETIMEDOUT
+#include <pthread.h>          // pthread_create(), pthread_cond_timedwait() et al.
 #include <sys/statvfs.h>      // statvfs()
 
 #define CANDIES_API static
@@ -12,14 +18,19 @@
 #define PROGRAM_URL  "https://github.com/domsson/candies/disk-statvfs"
 
 #define PROGRAM_VER_MAJOR 1
-#define PROGRAM_VER_MINOR 0
+#define PROGRAM_VER_MINOR 5
 #define PROGRAM_VER_PATCH 0
 
 #define DEFAULT_PATH        "/"
 #define DEFAULT_UNIT        "%"
 #define DEFAULT_INTERVAL     10
+#define DEFAULT_WINDOW       3600
+#define DEFAULT_TIMEOUT      1000
+#define MAX_FAILURES         3     // failed statvfs() in a row before giving up
 #define DEFAULT_GRANULARITY "g"
 #define DEFAULT_FORMAT      "%u"
+#define DEFAULT_SEPARATOR   " "
+#define DEFAULT_MOUNTINFO   "/proc/self/mountinfo"
 
 #define OUTPUT_SIZE 128
 #define RESULT_SIZE 16
@@ -37,10 +48,96 @@ struct info
 	double free_rel;
 	double avail_rel;
 	double used_rel;
+	ulong itotal_abs;   // inodes total
+	ulong ifree_abs;    // inodes free
+	ulong iavail_abs;   // inodes available to unpriviledged user
+	ulong iused_abs;    // inodes used
+	double ifree_rel;
+	double iavail_rel;
+	double iused_rel;
+
+	// prediction from the samples in the history
+	double fill_abs;    // disk space filled per hour (negative if freed)
+	double full_hrs;    // hours until no space is available, -1 if never
 };
 
 typedef struct info info_s;
 
+// Ring buffer of (time, used disk space) samples, allocated once per mount.
+// The sums for the least squares fit are updated as samples come and go, so
+// adding a sample and fitting the line are both O(1), regardless of size.
+struct history
+{
+	size_t size;         // capacity, in number of samples
+	size_t num;          // number of samples currently held
+	size_t head;         // index the next sample will be written to
+	double *t;           // seconds since the first sample
+	double *y;           // used bytes, relative to the first sample
+	double t_base;       // time of the first sample
+	double y_base;       // used bytes of the first sample
+	double sum_t;
+	double sum_y;
+	double sum_tt;
+	double sum_ty;
+};
+
+typedef struct history history_s;
+
+// Shared by the main thread and all workers; one lock guards all workers
+struct pool
+{
+	pthread_mutex_t lock;
+	pthread_cond_t done;     // signalled by workers when statvfs() returned
+};
+
+typedef struct pool pool_s;
+
+// Every mount has its own worker thread that calls statvfs() on request, so
+// that a hung mount only ever blocks its own worker. Once the main thread lets
+// go of a worker (see `orphan`), the worker frees its state on its own, which
+// might only be once the hung statvfs() returns, if ever.
+struct worker
+{
+	pool_s *pool;
+	pthread_cond_t wake;     // signalled by the main thread for a request
+	char *path;              // own copy, as the mount might go away
+	struct statvfs stat;     // result of the last statvfs()
+	byte request : 1;        // main thread wants a statvfs()
+	byte busy : 1;           // statvfs() in progress
+	byte fresh : 1;          // `stat` holds a result that wasn't picked up
+	byte failed : 1;         // last statvfs() returned an error
+	byte orphan : 1;         // main thread let go, worker should clean up
+	byte asked : 1;          // requested in the current probe, to be waited for
+};
+
+typedef struct worker worker_s;
+
+struct mount
+{
+	char *path;          // path to query (as given by the user, or mount point)
+	char *point;         // mount point the path resides on
+	char *type;          // filesystem type of the mount
+	info_s info;
+	history_s history;
+	worker_s *worker;
+	struct statvfs stat; // result of the last successful statvfs()
+	byte stale : 1;      // no result within the deadline, `info` is outdated
+	byte sampled : 1;    // `info` holds a result, even if outdated
+	int failures;        // statvfs() calls in a row that returned an error
+	char output_prev[OUTPUT_SIZE];
+	char output_curr[OUTPUT_SIZE];
+};
+
+typedef struct mount mount_s;
+
+struct mounts
+{
+	mount_s *list;
+	size_t num;
+};
+
+typedef struct mounts mounts_s;
+
 struct opts
 {
 	byte help : 1;       // show help and exit
@@ -50,9 +147,15 @@ struct opts
 	byte space : 1;      // print a space between value and unit
 	byte binary : 1;     // binary instead of decimal units (MiB vs MB etc)
 	byte continuous : 1; // continously print, even if no change in value
+	byte records : 1;    // print one line per mount instead of joining them
 	int interval;        // interval, in seconds, to check disk space
 	int precision;       // number of decimals in output
-	char *path;          // path of a file on the desired disk/mount
+	int window;          // seconds of history used for the fill rate
+	int timeout;         // milliseconds to wait for statvfs() to return
+	char **paths;        // paths of files on the desired disks/mounts
+	size_t num_paths;    // number of elements in `paths`
+	char *types;         // comma-separated list of filesystem types
+	char *separator;     // separator between mounts (if not `records`)
 	char *format;
 	char granularity;    // unit granularity (m = mega, g = giga, etc) 
 
@@ -66,9 +169,8 @@ struct context
 {
 	info_s* info;
 	opts_s* opts;
+	mount_s* mount;
 	char buffer[RESULT_SIZE];
-	char output_prev[OUTPUT_SIZE];
-	char output_curr[OUTPUT_SIZE];
 };
 
 typedef struct context ctx_s;
@@ -76,9 +178,12 @@ typedef struct context ctx_s;
 static void
 fetch_opts(opts_s *opts, int argc, char **argv)
 {
+	// there can't be more paths than arguments
+	opts->paths = calloc(argc, sizeof(char*));
+
 	opterr = 0;
 	int o;
-	while ((o = getopt(argc, argv, "bd:f:g:hi:kmp:suV")) != -1)
+	while ((o = getopt(argc, argv, "bd:f:g:hi:kmp:rS:sT:t:uVw:")) != -1)
 	{
 		switch (o)
 		{
@@ -86,7 +191,7 @@ fetch_opts(opts_s *opts, int argc, char **argv)
 				opts->binary = 1;
 				break;
 			case 'd':
-				opts->path = optarg;
+				opts->paths[opts->num_paths++] = optarg;
 				break;
 			case 'f':
 				opts->format = optarg;
@@ -109,15 +214,30 @@ fetch_opts(opts_s *opts, int argc, char **argv)
 			case 'p':
 				opts->precision = atoi(optarg);
 				break;
+			case 'r':
+				opts->records = 1;
+				break;
+			case 'S':
+				opts->separator = optarg;
+				break;
 			case 's':
 				opts->space = 1;
 				break;
+			case 'T':
+				opts->types = optarg;
+				break;
+			case 't':
+				opts->timeout = atoi(optarg);
+				break;
 			case 'u':
 				opts->unit = 1;
 				break;
 			case 'V':
 				opts->version = 1;
 				break;
+			case 'w':
+				opts->window = atoi(optarg);
+				break;
 		}
 	}
 }
@@ -130,7 +250,7 @@ help(char *invocation, FILE* stream)
 	fprintf(stream, "\n");
 	fprintf(stream, "Options:\n");
 	fprintf(stream, "\t-b Use binary instead of decimal units\n");
-	fprintf(stream, "\t-d PATH Dir/ file to query for disk space; default is '/'\n");
+	fprintf(stream, "\t-d PATH Dir/ file to query for disk space, can be repeated; default is '/'\n");
 	fprintf(stream, "\t-f FORMAT Format string for output, default is '%%u'\n");
 	fprintf(stream, "\t-g GRANULARITY Value granularity (k, m, g, t, p); default is 'g'\n");
 	fprintf(stream, "\t-h Print this help text and exit\n");
@@ -138,15 +258,29 @@ help(char *invocation, FILE* stream)
 	fprintf(stream, "\t-k Keep printing even if the output hasn't changed\n");
 	fprintf(stream, "\t-m Keep running and print when there is a change in output\n"); 
 	fprintf(stream, "\t-p Number of decimal digits in the output; default is 0\n");
+	fprintf(stream, "\t-r Print one line per mount instead of joining them\n");
+	fprintf(stream, "\t-S SEPARATOR String to put between mounts (without -r); default is ' '\n");
 	fprintf(stream, "\t-s Print a space between value and unit\n");
+	fprintf(stream, "\t-T TYPES Query all mounts of these filesystem types (comma-separated)\n");
+	fprintf(stream, "\t-t TIMEOUT Milliseconds after which a mount is considered stale; default is 1000\n");
 	fprintf(stream, "\t-u Print the appropriate unit after the value\n");
 	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\t-w WINDOW Seconds of history for fill rate and time until full; default is 3600\n");
 	fprintf(stream, "\n");
 	fprintf(stream, "Format specifiers:\n");
 	fprintf(stream, "\t%%T and %%t: Total disk space (absolute and percent)\n");
 	fprintf(stream, "\t%%F and %%f: Free disk space (absolute and percent)\n");
 	fprintf(stream, "\t%%U and %%u: Used disk space (absolute and percent)\n");
 	fprintf(stream, "\t%%A and %%a: Free disk space avail. to unprivileged users (absolute and percent)\n");
+	fprintf(stream, "\t%%N: Total inodes\n");
+	fprintf(stream, "\t%%E and %%e: Free inodes (absolute and percent)\n");
+	fprintf(stream, "\t%%I and %%i: Used inodes (absolute and percent)\n");
+	fprintf(stream, "\t%%V and %%v: Free inodes avail. to unprivileged users (absolute and percent)\n");
+	fprintf(stream, "\t%%R: Fill rate (disk space per hour, negative if freed)\n");
+	fprintf(stream, "\t%%H: Hours until no disk space is available ('-' if not filling up)\n");
+	fprintf(stream, "\t%%m: Mount point\n");
+	fprintf(stream, "\t%%y: Filesystem type\n");
+	fprintf(stream, "\t%%s: '*' if the mount didn't respond in time (value is outdated), else nothing\n");
 }
 
 /*
@@ -160,33 +294,747 @@ version(FILE *stream)
 			PROGRAM_URL);
 }
 
+/*
+ * Decodes the octal escapes (like `\040` for space) used in mountinfo, in place.
+ */
+static char*
+unescape(char *str)
+{
+	char *r = str;
+	char *w = str;
+	for (; *r; ++r, ++w)
+	{
+		if (r[0] == '\\' && r[1] >= '0' && r[1] <= '3' &&
+		    r[2] >= '0' && r[2] <= '7' && r[3] >= '0' && r[3] <= '7')
+		{
+			*w = ((r[1] - '0') << 6) | ((r[2] - '0') << 3) | (r[3] - '0');
+			r += 3;
+		}
+		else
+		{
+			*w = *r;
+		}
+	}
+	*w = '\0';
+	return str;
+}
+
+/*
+ * Checks whether `type` is contained in the comma-separated list `types`.
+ */
+static int
+has_type(const char *types, const char *type)
+{
+	size_t len = strlen(type);
+	while (types && *types)
+	{
+		size_t tlen = strcspn(types, ",");
+		if (tlen == len && strncmp(types, type, len) == 0)
+		{
+			return 1;
+		}
+		types += tlen;
+		types += *types == ',';
+	}
+	return 0;
+}
+
+/*
+ * Appends a mount to the list. `point` and `type` will be copied, `path` will
+ * point to `point` if NULL, otherwise it will also be copied.
+ * Returns the new mount on success, NULL on error.
+ */
+static mount_s*
+add_mount(mounts_s *mounts, const char *path, const char *point, const char *type)
+{
+	mount_s *list = realloc(mounts->list, sizeof(mount_s) * (mounts->num + 1));
+	if (list == NULL)
+	{
+		return NULL;
+	}
+	mounts->list = list;
+
+	mount_s *mount = &mounts->list[mounts->num++];
+	*mount = (const mount_s) { 0 };
+	mount->point = strdup(point);
+	mount->type  = strdup(type);
+	mount->path  = path ? strdup(path) : mount->point;
+	if (mount->point == NULL || mount->type == NULL || mount->path == NULL)
+	{
+		if (mount->path != mount->point)
+		{
+			free(mount->path);
+		}
+		free(mount->point);
+		free(mount->type);
+		--mounts->num;
+		return NULL;
+	}
+	return mount;
+}
+
+static void*
+worker_main(void *arg)
+{
+	worker_s *worker = arg;
+	pool_s *pool = worker->pool;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1)
+	{
+		while (!worker->request && !worker->orphan)
+		{
+			pthread_cond_wait(&worker->wake, &pool->lock);
+		}
+		if (worker->orphan)
+		{
+			break;
+		}
+		worker->request = 0;
+		worker->busy = 1;
+		pthread_mutex_unlock(&pool->lock);
+
+		// this is the call that might never return (dead NFS server etc)
+		struct statvfs stat = { 0 };
+		int res = statvfs(worker->path, &stat);
+
+		pthread_mutex_lock(&pool->lock);
+		worker->stat   = stat;
+		worker->failed = res == -1;
+		worker->fresh  = 1;
+		worker->busy   = 0;
+		pthread_cond_broadcast(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	pthread_cond_destroy(&worker->wake);
+	free(worker->path);
+	free(worker);
+	return NULL;
+}
+
+/*
+ * Creates a (detached) worker thread for the given path.
+ * Returns the new worker on success, NULL on error.
+ */
+static worker_s*
+worker_create(pool_s *pool, const char *path)
+{
+	worker_s *worker = calloc(1, sizeof(worker_s));
+	if (worker == NULL)
+	{
+		return NULL;
+	}
+	worker->pool = pool;
+	worker->path = strdup(path);
+	pthread_cond_init(&worker->wake, NULL);
+
+	pthread_t thread;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (worker->path == NULL || pthread_create(&thread, &attr, worker_main, worker) != 0)
+	{
+		pthread_attr_destroy(&attr);
+		pthread_cond_destroy(&worker->wake);
+		free(worker->path);
+		free(worker);
+		return NULL;
+	}
+	pthread_attr_destroy(&attr);
+	return worker;
+}
+
+/*
+ * Lets go of the worker; it will free itself once it is done with whatever
+ * it is doing. The worker must not be accessed after this.
+ */
+static void
+worker_release(worker_s *worker)
+{
+	pool_s *pool = worker->pool;
+	pthread_mutex_lock(&pool->lock);
+	worker->orphan = 1;
+	pthread_cond_signal(&worker->wake);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void
+free_mounts(mounts_s *mounts)
+{
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		if (mounts->list[i].path != mounts->list[i].point)
+		{
+			free(mounts->list[i].path);
+		}
+		free(mounts->list[i].point);
+		free(mounts->list[i].type);
+		free(mounts->list[i].history.t);
+		free(mounts->list[i].history.y);
+		if (mounts->list[i].worker)
+		{
+			worker_release(mounts->list[i].worker);
+		}
+	}
+	free(mounts->list);
+	mounts->list = NULL;
+	mounts->num = 0;
+}
+
+/*
+ * Finds the mount the given path resides on, which is the one with the longest
+ * mount point that is a prefix of the path. Returns NULL if none was found.
+ */
+static mount_s*
+find_mount(mounts_s *mounts, const char *path)
+{
+	mount_s *found = NULL;
+	size_t found_len = 0;
+
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		const char *point = mounts->list[i].point;
+		size_t len = strlen(point);
+
+		if (strncmp(path, point, len) != 0)
+		{
+			continue;
+		}
+		// make sure "/mnt/data" doesn't match "/mnt/data2"
+		if (len > 1 && path[len] != '/' && path[len] != '\0')
+		{
+			continue;
+		}
+		// later mounts on the same point hide earlier ones, hence `>=`
+		if (len >= found_len)
+		{
+			found = &mounts->list[i];
+			found_len = len;
+		}
+	}
+	return found;
+}
+
+/*
+ * Reads all mounts from the given file, which is expected to be in the format
+ * of `/proc/self/mountinfo`. Returns 0 on success, -1 on error.
+ */
+static int
+read_mountinfo(const char *file, mounts_s *all)
+{
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+
+	// Example line (fields after the mount point vary in number, hence
+	// the separator " - ", after which the filesystem type follows):
+	// 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw
+	char *buf = NULL;
+	size_t len = 0;
+	while (getline(&buf, &len, fp) != -1)
+	{
+		char *save  = NULL;
+		char *point = NULL;
+		char *token = NULL;
+		int i;
+		for (i = 0; (token = strtok_r(i == 0 ? buf : NULL, " \n", &save)); ++i)
+		{
+			if (i == 4)
+			{
+				point = unescape(token);
+			}
+			if (i > 5 && strcmp(token, "-") == 0)
+			{
+				token = strtok_r(NULL, " \n", &save);
+				break;
+			}
+		}
+
+		if (point && token && add_mount(all, NULL, point, unescape(token)) == NULL)
+		{
+			free(buf);
+			fclose(fp);
+			return -1;
+		}
+	}
+
+	free(buf);
+	fclose(fp);
+	return 0;
+}
+
+/*
+ * Builds the list of mounts to query, based on the paths and filesystem types
+ * given by the user. All mounts are enumerated only once for this, from 
+ * `/proc/self/mountinfo`. If `strict` is not set, paths that can't be resolved
+ * (for example, because the media they were on has been removed) are skipped.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+load_mounts(opts_s *opts, mounts_s *mounts, int strict)
+{
+	mounts_s all = { 0 };
+	if (read_mountinfo(DEFAULT_MOUNTINFO, &all) == -1)
+	{
+		free_mounts(&all);
+		return -1;
+	}
+
+	// all mounts of the requested filesystem types
+	for (size_t i = 0; opts->types && i < all.num; ++i)
+	{
+		mount_s *curr = &all.list[i];
+		if (!has_type(opts->types, curr->type))
+		{
+			continue;
+		}
+
+		// a later mount on the same point hides the earlier one
+		mount_s *prev = find_mount(mounts, curr->point);
+		if (prev && strcmp(prev->point, curr->point) == 0)
+		{
+			char *type = strdup(curr->type);
+			if (type == NULL)
+			{
+				free_mounts(&all);
+				return -1;
+			}
+			free(prev->type);
+			prev->type = type;
+			continue;
+		}
+
+		if (add_mount(mounts, NULL, curr->point, curr->type) == NULL)
+		{
+			free_mounts(&all);
+			return -1;
+		}
+	}
+
+	// all paths given explicitly, with the mount they reside on
+	for (size_t i = 0; i < opts->num_paths; ++i)
+	{
+		char real[PATH_MAX];
+		mount_s *found = NULL;
+		char *resolved = realpath(opts->paths[i], real);
+		if (resolved == NULL && !strict)
+		{
+			continue;
+		}
+		if (resolved == NULL || 
+				(found = find_mount(&all, real)) == NULL ||
+				add_mount(mounts, opts->paths[i], found->point, found->type) == NULL)
+		{
+			free_mounts(&all);
+			return -1;
+		}
+	}
+
+	free_mounts(&all);
+	return 0;
+}
+
+static double
+get_time()
+{
+	struct timespec ts = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/*
+ * Checks whether the format string makes use of any of the given specifiers.
+ */
+static int
+uses_specifier(const char *format, const char *specifiers)
+{
+	for (; *format; ++format)
+	{
+		if (*format == '%' && format[1])
+		{
+			if (strchr(specifiers, *++format))
+			{
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Allocates the history ring buffers for `size` samples for all mounts that 
+ * don't have one yet. Returns 0 on success, -1 on error.
+ */
+static int
+init_history(mounts_s *mounts, size_t size)
+{
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		history_s *hist = &mounts->list[i].history;
+		if (hist->size)
+		{
+			continue;
+		}
+		hist->t = calloc(size, sizeof(double));
+		hist->y = calloc(size, sizeof(double));
+		if (hist->t == NULL || hist->y == NULL)
+		{
+			return -1;
+		}
+		hist->size = size;
+	}
+	return 0;
+}
+
+/*
+ * Makes the oldest sample in the (full) history the new base, so that times 
+ * and sizes stay small and the sums don't lose precision over long uptimes.
+ * The sums are recomputed from scratch, which is O(n), but only needs to be 
+ * done once every `size` samples.
+ */
+static void
+history_rebase(history_s *hist)
+{
+	double dt = hist->t[hist->head];
+	double dy = hist->y[hist->head];
+
+	hist->t_base += dt;
+	hist->y_base += dy;
+	hist->sum_t  = 0.0;
+	hist->sum_y  = 0.0;
+	hist->sum_tt = 0.0;
+	hist->sum_ty = 0.0;
+
+	for (size_t i = 0; i < hist->num; ++i)
+	{
+		double t = hist->t[i] -= dt;
+		double y = hist->y[i] -= dy;
+		hist->sum_t  += t;
+		hist->sum_y  += y;
+		hist->sum_tt += t * t;
+		hist->sum_ty += t * y;
+	}
+}
+
+/*
+ * Adds a sample to the history, overwriting (and subtracting from the sums)
+ * the oldest one if the history is full.
+ */
+static void
+history_add(history_s *hist, double time, ulong used)
+{
+	if (hist->num == 0 && hist->head == 0)
+	{
+		hist->t_base = time;
+		hist->y_base = used;
+	}
+
+	if (hist->num == hist->size)
+	{
+		double t = hist->t[hist->head];
+		double y = hist->y[hist->head];
+		hist->sum_t  -= t;
+		hist->sum_y  -= y;
+		hist->sum_tt -= t * t;
+		hist->sum_ty -= t * y;
+		--hist->num;
+	}
+
+	double t = time - hist->t_base;
+	double y = used - hist->y_base;
+	hist->t[hist->head] = t;
+	hist->y[hist->head] = y;
+	hist->sum_t  += t;
+	hist->sum_y  += y;
+	hist->sum_tt += t * t;
+	hist->sum_ty += t * y;
+
+	hist->head = (hist->head + 1) % hist->size;
+	++hist->num;
+
+	// re-anchor whenever the ring buffer has come full circle
+	if (hist->head == 0 && hist->num == hist->size)
+	{
+		history_rebase(hist);
+	}
+}
+
+/*
+ * Fits a line through the samples in the history (least squares) and derives
+ * the fill rate and the time until no space is available from its slope.
+ */
+static void
+history_fit(history_s *hist, info_s *info)
+{
+	info->fill_abs = 0.0;
+	info->full_hrs = -1.0;
+
+	double n = hist->num;
+	double d = n * hist->sum_tt - hist->sum_t * hist->sum_t;
+	if (hist->num < 2 || d <= 0.0)
+	{
+		return;
+	}
+
+	// slope in bytes per second
+	double slope = (n * hist->sum_ty - hist->sum_t * hist->sum_y) / d;
+	info->fill_abs = slope * 3600.0;
+
+	if (slope > 0.0)
+	{
+		info->full_hrs = (info->avail_abs / slope) / 3600.0;
+	}
+}
+
+/*
+ * Creates a worker for all mounts that don't have one yet. 
+ * Returns 0 on success, -1 on error.
+ */
+static int
+init_workers(pool_s *pool, mounts_s *mounts)
+{
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		mount_s *mount = &mounts->list[i];
+		if (mount->worker == NULL && 
+				(mount->worker = worker_create(pool, mount->path)) == NULL)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Asks the workers of all mounts to call statvfs(), then waits for them to 
+ * return for at most `timeout` milliseconds. A worker that is still stuck in
+ * a previous call is neither asked again nor waited for, so there is never 
+ * more than one call per mount, and a hung mount doesn't make every probe 
+ * take the full timeout. Mounts that didn't get a result in time are marked 
+ * as stale, all others get a copy of the result in `stat`.
+ */
+static void
+probe_mounts(pool_s *pool, mounts_s *mounts, int timeout)
+{
+	struct timespec deadline = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec  += timeout / 1000;
+	deadline.tv_nsec += (timeout % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec  += 1;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		worker_s *worker = mounts->list[i].worker;
+		worker->asked = !worker->busy;
+		if (worker->asked)
+		{
+			worker->request = 1;
+			pthread_cond_signal(&worker->wake);
+		}
+	}
+
+	size_t pending = mounts->num;
+	while (pending)
+	{
+		pending = 0;
+		for (size_t i = 0; i < mounts->num; ++i)
+		{
+			worker_s *worker = mounts->list[i].worker;
+			pending += worker->asked && (worker->request || worker->busy);
+		}
+		if (pending && pthread_cond_timedwait(&pool->done, &pool->lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		mount_s *mount = &mounts->list[i];
+		worker_s *worker = mount->worker;
+		mount->stale = !worker->fresh || worker->failed;
+		if (!mount->stale)
+		{
+			mount->stat = worker->stat;
+		}
+		if (worker->fresh)
+		{
+			mount->failures = worker->failed ? mount->failures + 1 : 0;
+		}
+		worker->fresh = 0;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Rebuilds the list of mounts after the mount table has changed. The previous
+ * output, info, history and worker of mounts that are still present are 
+ * carried over, so that only new or changed mounts will be printed (if 
+ * `records` is set). 
+ * Returns 0 on success, -1 on error.
+ */
 static int
-fetch_info(info_s* info, opts_s* opts)
+reload_mounts(opts_s *opts, mounts_s *mounts)
 {
-	struct statvfs stat = { 0 };
-	if (statvfs(opts->path, &stat) == -1)
+	mounts_s fresh = { 0 };
+	if (load_mounts(opts, &fresh, 0) == -1)
 	{
+		free_mounts(&fresh);
 		return -1;
 	}
 
+	for (size_t i = 0; i < fresh.num; ++i)
+	{
+		for (size_t j = 0; j < mounts->num; ++j)
+		{
+			mount_s *curr = &fresh.list[i];
+			mount_s *prev = &mounts->list[j];
+			if (strcmp(curr->path, prev->path) != 0 || 
+					strcmp(curr->point, prev->point) != 0)
+			{
+				continue;
+			}
+			strcpy(curr->output_prev, prev->output_prev);
+			curr->info    = prev->info;
+			curr->stale   = prev->stale;
+			curr->sampled = prev->sampled;
+			curr->failures = prev->failures;
+			curr->history = prev->history;
+			curr->worker  = prev->worker;
+			prev->history = (const history_s) { 0 };
+			prev->worker  = NULL;
+			break;
+		}
+	}
+
+	free_mounts(mounts);
+	*mounts = fresh;
+	return 0;
+}
+
+/*
+ * Waits for `interval` seconds or until the kernel signals a change in the 
+ * mount table via the given (open) mountinfo file, whichever comes first.
+ * If `fd` is -1, simply sleeps for `interval` seconds instead.
+ * Returns 1 if the mount table has changed, 0 otherwise.
+ */
+static int
+wait_interval(int fd, int interval)
+{
+	if (fd == -1)
+	{
+		sleep(interval);
+		return 0;
+	}
+
+	// the kernel flags mountinfo with POLLERR|POLLPRI on every mount/umount
+	struct pollfd pfd = { .fd = fd, .events = POLLPRI };
+	if (poll(&pfd, 1, interval * 1000) <= 0)
+	{
+		return 0;
+	}
+	return (pfd.revents & (POLLERR | POLLPRI)) != 0;
+}
+
+static void
+fetch_info(info_s* info, const struct statvfs* stat)
+{
 	// usually f_frsize == f_bsize 
-	info->total_abs = stat.f_bsize * stat.f_blocks;
-	info->avail_abs = stat.f_bsize * stat.f_bavail;
-	info->free_abs  = stat.f_bsize * stat.f_bfree;
+	info->total_abs = stat->f_bsize * stat->f_blocks;
+	info->avail_abs = stat->f_bsize * stat->f_bavail;
+	info->free_abs  = stat->f_bsize * stat->f_bfree;
 	info->used_abs  = info->total_abs - info->free_abs;
 
+	info->itotal_abs = stat->f_files;
+	info->iavail_abs = stat->f_favail;
+	info->ifree_abs  = stat->f_ffree;
+	info->iused_abs  = info->itotal_abs - info->ifree_abs;
+
+	// some filesystems (btrfs, ...) have no fixed number of inodes
+	if (info->itotal_abs)
+	{
+		info->iavail_rel = ((double) info->iavail_abs / (double) info->itotal_abs) * 100.0;
+		info->ifree_rel  = ((double) info->ifree_abs  / (double) info->itotal_abs) * 100.0;
+		info->iused_rel  = ((double) info->iused_abs  / (double) info->itotal_abs) * 100.0;
+	}
+
+	// pseudo filesystems (proc, sysfs, ...) report a total size of 0
+	if (info->total_abs == 0)
+	{
+		return;
+	}
+
 	info->total_rel = 100.0;
 	info->avail_rel = ((double) info->avail_abs / (double) info->total_abs) * 100.0;
 	info->free_rel  = ((double) info->free_abs  / (double) info->total_abs) * 100.0;
 	info->used_rel  = ((double) info->used_abs  / (double) info->total_abs) * 100.0;
-
-	return 0;
 }
 
 static void
-format_info(ctx_s* ctx)
+format_info(ctx_s* ctx, mount_s* mount)
+{
+	ctx->info  = &mount->info;
+	ctx->mount = mount;
+	candy_format(ctx->opts->format, mount->output_curr, OUTPUT_SIZE, candy_format_cb, ctx);
+}
+
+/*
+ * Prints the output of all mounts, either joined into one line or one line
+ * per mount. In the latter case, only mounts with changed output are printed,
+ * unless `all` is set. Returns the number of mounts printed.
+ */
+static size_t
+print_mounts(mounts_s* mounts, opts_s* opts, int all)
 {
-	candy_format(ctx->opts->format, ctx->output_curr, OUTPUT_SIZE, candy_format_cb, ctx);
+	size_t printed = 0;
+
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		mount_s *mount = &mounts->list[i];
+		if (opts->records && !all && strcmp(mount->output_prev, mount->output_curr) == 0)
+		{
+			continue;
+		}
+		if (opts->records)
+		{
+			fprintf(stdout, "%s\n", mount->output_curr);
+		}
+		else
+		{
+			fprintf(stdout, "%s%s", i ? opts->separator : "", mount->output_curr);
+		}
+		++printed;
+	}
+
+	if (!opts->records)
+	{
+		fprintf(stdout, "\n");
+	}
+	return printed;
+}
+
+/*
+ * Checks if the output of any of the mounts has changed.
+ */
+static int
+output_changed(mounts_s* mounts)
+{
+	for (size_t i = 0; i < mounts->num; ++i)
+	{
+		if (strcmp(mounts->list[i].output_prev, mounts->list[i].output_curr) != 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
 }
 
 static void
@@ -211,11 +1059,52 @@ format_abs_value(char *buf, size_t len, double val, opts_s* opts)
 	);
 }
 
+static void
+format_cnt_value(char *buf, size_t len, ulong val)
+{
+	snprintf(buf, len, "%lu", val);
+}
+
+static void
+format_fill_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s%s",
+		opts->precision,
+		val / opts->unit_size,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? opts->unit_abbr : "",
+		opts->unit ? "/h" : ""
+	);
+}
+
+static void
+format_hrs_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	if (val < 0.0)
+	{
+		snprintf(buf, len, "-");
+		return;
+	}
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? "h" : ""
+	);
+}
+
 static char*
 candy_format_cb(char c, void* context)
 {
 	ctx_s* ctx = (ctx_s*) context;
 
+	// no result yet (the mount hung or failed from the start), so there are 
+	// no values to print, and zeros would look like real ones
+	if (!ctx->mount->sampled && strchr("tfuaTFUANeivEIVRH", c))
+	{
+		return "-";
+	}
+
 	switch(c)
 	{
 		case 't':	// disk space total, percent
@@ -250,6 +1139,48 @@ candy_format_cb(char c, void* context)
 			format_abs_value(ctx->buffer, RESULT_SIZE,
 					ctx->info->avail_abs, ctx->opts);
 			return ctx->buffer;
+		case 'N':	// inodes total
+			format_cnt_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->itotal_abs);
+			return ctx->buffer;
+		case 'e':	// inodes free, percent
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->ifree_rel, ctx->opts);
+			return ctx->buffer;
+		case 'i':	// inodes used, percent
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->iused_rel, ctx->opts);
+			return ctx->buffer;
+		case 'v':	// inodes avail. to unpriv. users, percent
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->iavail_rel, ctx->opts);
+			return ctx->buffer;
+		case 'E':	// inodes free, absolute
+			format_cnt_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->ifree_abs);
+			return ctx->buffer;
+		case 'I':	// inodes used, absolute
+			format_cnt_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->iused_abs);
+			return ctx->buffer;
+		case 'V':	// inodes avail. to unpriv. users, absolute
+			format_cnt_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->iavail_abs);
+			return ctx->buffer;
+		case 'R':	// fill rate, per hour
+			format_fill_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->fill_abs, ctx->opts);
+			return ctx->buffer;
+		case 'H':	// hours until full
+			format_hrs_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->full_hrs, ctx->opts);
+			return ctx->buffer;
+		case 'm':	// mount point
+			return ctx->mount->point;
+		case 'y':	// filesystem type
+			return ctx->mount->type;
+		case 's':	// stale marker
+			return ctx->mount->stale ? "*" : "";
 		default:
 			return NULL;
 	}
@@ -265,6 +1196,7 @@ main(int argc, char **argv)
 	if (opts.help)
 	{
 		help(argv[0], stdout);
+		free(opts.paths);
 		return EXIT_SUCCESS;
 	}
 
@@ -272,12 +1204,18 @@ main(int argc, char **argv)
 	if (opts.version)
 	{
 		version(stdout);
+		free(opts.paths);
 		return EXIT_SUCCESS;
 	}
 
-	if (opts.path == NULL)
+	if (opts.num_paths == 0 && opts.types == NULL)
+	{
+		opts.paths[opts.num_paths++] = DEFAULT_PATH;
+	}
+
+	if (opts.separator == NULL)
 	{
-		opts.path = DEFAULT_PATH;
+		opts.separator = DEFAULT_SEPARATOR;
 	}
 
 	if (opts.format == NULL)
@@ -296,6 +1234,26 @@ main(int argc, char **argv)
 		opts.interval = DEFAULT_INTERVAL;
 	}
 
+	// if no window size given, use the default
+	if (opts.window <= 0)
+	{
+		opts.window = DEFAULT_WINDOW;
+	}
+
+	// if no timeout given, use the default
+	if (opts.timeout <= 0)
+	{
+		opts.timeout = DEFAULT_TIMEOUT;
+	}
+
+	// number of samples in the history (if needed at all), at least two
+	size_t history = 0;
+	if (opts.monitor && uses_specifier(opts.format, "RH"))
+	{
+		history = opts.window / opts.interval;
+		history = history < 2 ? 2 : history;
+	}
+
 	// set interval to 0 if we don't monitor (run only once)
 	if (opts.monitor == 0)
 	{
@@ -306,37 +1264,117 @@ main(int argc, char **argv)
 	setlinebuf(stdout);
 
 	// important data structures for processing
-	info_s info = { 0 };
-	ctx_s ctx = { .info = &info, .opts = &opts };
+	mounts_s mounts = { 0 };
+	ctx_s ctx = { .opts = &opts };
+	int mountinfo = -1;
+	int changed = 0;
+
+	// the pool might still be used by hung workers when we return, hence static
+	static pool_s pool = { .lock = PTHREAD_MUTEX_INITIALIZER };
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&pool.done, &attr);
+	pthread_condattr_destroy(&attr);
+
+	// figure out which mounts to query (again only if the mount table changes)
+	if (load_mounts(&opts, &mounts, 1) == -1 || mounts.num == 0)
+	{
+		free_mounts(&mounts);
+		free(opts.paths);
+		return EXIT_FAILURE;
+	}
 
 	// set additional members of the opts struct based on the granularity
 	candy_unit_info(opts.granularity, opts.binary, &opts.unit_size, &opts.unit_abbr);
 
+	// allocate the history for the fill rate once per mount, if we need it,
+	// and start a worker for every mount
+	if ((history && init_history(&mounts, history) == -1) || 
+			init_workers(&pool, &mounts) == -1)
+	{
+		free_mounts(&mounts);
+		free(opts.paths);
+		return EXIT_FAILURE;
+	}
+
+	// keep mountinfo open to get notified about mount/umount when monitoring
+	if (opts.monitor)
+	{
+		mountinfo = open(DEFAULT_MOUNTINFO, O_RDONLY | O_CLOEXEC);
+	}
+
 	do
 	{
-		// fetch the disk usage and place it in the info struct
-		if (fetch_info(&info, &opts) == -1)
+		// have the workers call statvfs(), but don't wait for hung mounts
+		probe_mounts(&pool, &mounts, opts.timeout);
+
+		for (size_t i = 0; i < mounts.num; ++i)
 		{
-			return EXIT_FAILURE;
+			mount_s *mount = &mounts.list[i];
+
+			// stale mounts keep their last known disk usage
+			if (!mount->stale)
+			{
+				fetch_info(&mount->info, &mount->stat);
+				mount->sampled = 1;
+			}
+
+			// without a result when running once, or if statvfs() keeps
+			// failing, there is nothing sensible to print
+			if ((!opts.monitor && !mount->sampled) || mount->failures >= MAX_FAILURES)
+			{
+				close(mountinfo);
+				free_mounts(&mounts);
+				free(opts.paths);
+				return EXIT_FAILURE;
+			}
+
+			// add the sample to the history and update the prediction
+			if (mount->history.size && !mount->stale)
+			{
+				history_add(&mount->history, get_time(), mount->info.used_abs);
+			}
+			history_fit(&mount->history, &mount->info);
+
+			// formulate the output string based on opts->format
+			format_info(&ctx, mount);
 		}
-		
-		// formulate the final output string based on opts->format
-		format_info(&ctx);
 
-		// print
-		if (opts.continuous || strcmp(ctx.output_prev, ctx.output_curr) != 0)
+		// print (also if mounts have been added or removed)
+		if (opts.continuous || changed || output_changed(&mounts))
 		{
-			fprintf(stdout, "%s\n", ctx.output_curr);
+			print_mounts(&mounts, &opts, opts.continuous);
 		}
 		
 		// update values for next iteration
-		strcpy(ctx.output_prev, ctx.output_curr);
+		for (size_t i = 0; i < mounts.num; ++i)
+		{
+			strcpy(mounts.list[i].output_prev, mounts.list[i].output_curr);
+		}
 		
-		// sleep, maybe (if interval > 0)
-		sleep(opts.interval);
+		// sleep, maybe (if interval > 0), or until the mount table changes
+		changed = wait_interval(mountinfo, opts.interval);
+
+		// rebuild the list of mounts if the mount table has changed
+		if (changed && (reload_mounts(&opts, &mounts) == -1 ||
+				(history && init_history(&mounts, history) == -1) ||
+				init_workers(&pool, &mounts) == -1))
+		{
+			close(mountinfo);
+			free_mounts(&mounts);
+			free(opts.paths);
+			return EXIT_FAILURE;
+		}
 	}
 	while (opts.monitor);
 
+	if (mountinfo != -1)
+	{
+		close(mountinfo);
+	}
+	free_mounts(&mounts);
+	free(opts.paths);
 	return EXIT_SUCCESS;
 }
 
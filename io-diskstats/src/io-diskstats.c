@@ -0,0 +1,696 @@
+#include <stdio.h>            // fprintf
+#include <stdlib.h>           // NULL, EXIT_*
+#include <unistd.h>           // getopt() et al., pread(), close()
+#include <ctype.h>            // tolower()
+#include <string.h>           // strcpy(), strcmp()
+#include <fcntl.h>            // open(), openat()
+#include <dirent.h>           // opendir(), readdir()
+#include <sys/stat.h>         // fstatat()
+
+#define CANDIES_API static
+#include "candies.h"
+
+#define PROGRAM_NAME "io-diskstats"
+#define PROGRAM_URL  "https://github.com/domsson/candies/io-diskstats"
+
+#define PROGRAM_VER_MAJOR 0
+#define PROGRAM_VER_MINOR 1
+#define PROGRAM_VER_PATCH 0
+
+#define DEFAULT_INTERVAL     1
+#define DEFAULT_GRANULARITY "m"
+#define DEFAULT_FORMAT      "%u"
+#define DEFAULT_SEPARATOR   " "
+#define DEFAULT_BLOCKDIR    "/sys/block"
+#define DEFAULT_TOTAL_NAME  "total"
+
+#define STAT_FILE_FORMAT "%s/%s/stat"
+#define STAT_FILE_BUFLEN  256
+#define SECTOR_SIZE       512  // diskstats always count 512 byte sectors
+
+#define NAME_SIZE   32
+#define OUTPUT_SIZE 128
+#define RESULT_SIZE 16
+
+typedef unsigned long ulong;
+typedef unsigned char byte;
+
+// Raw counters from a block device's stat file (see the kernel's
+// Documentation/block/stat.rst), accumulated since boot
+struct stats
+{
+	ulong rd_ios;        // read I/Os completed
+	ulong rd_sectors;    // sectors read
+	ulong rd_ticks;      // milliseconds spent reading
+	ulong wr_ios;        // write I/Os completed
+	ulong wr_sectors;    // sectors written
+	ulong wr_ticks;      // milliseconds spent writing
+	ulong io_ticks;      // milliseconds spent doing I/O (busy time)
+};
+
+typedef struct stats stats_s;
+
+struct info
+{
+	ulong rd_bytes;      // bytes read per second
+	ulong wr_bytes;      // bytes written per second
+	ulong tx_bytes;      // bytes read and written per second
+	double rd_iops;      // read I/Os per second
+	double wr_iops;      // write I/Os per second
+	double tx_iops;      // read and write I/Os per second
+	double await;        // average time per I/O, in milliseconds
+	double util;         // percentage of time the device was busy
+};
+
+typedef struct info info_s;
+
+struct disk
+{
+	char name[NAME_SIZE];
+	int fd;              // held-open stat file, -1 for the aggregate
+	stats_s prev;
+	stats_s curr;
+	info_s info;
+	char output_prev[OUTPUT_SIZE];
+	char output_curr[OUTPUT_SIZE];
+};
+
+typedef struct disk disk_s;
+
+struct disks
+{
+	disk_s *list;
+	size_t num;
+};
+
+typedef struct disks disks_s;
+
+struct opts
+{
+	byte help : 1;       // show help and exit
+	byte version : 1;    // show version info and exit
+	byte monitor : 1;    // keep running and printing
+	byte unit : 1;       // print a unit character
+	byte space : 1;      // print a space between value and unit
+	byte binary : 1;     // binary instead of decimal units (MiB vs MB etc)
+	byte continuous : 1; // continously print, even if no change in value
+	byte records : 1;    // print one line per device instead of joining them
+	byte total : 1;      // add the aggregate over all devices
+	int interval;        // interval, in seconds, to check disk stats
+	int precision;       // number of decimals in output
+	char **devices;      // names of the block devices of interest
+	size_t num_devices;  // number of elements in `devices`
+	char *separator;     // separator between devices (if not `records`)
+	char *format;
+	char granularity;    // unit granularity (m = mega, g = giga, etc)
+
+	ulong unit_size;     // will be set by program
+	char *unit_abbr;     // will be set by program
+};
+
+typedef struct opts opts_s;
+
+struct context
+{
+	info_s* info;
+	opts_s* opts;
+	disk_s* disk;
+	char buffer[RESULT_SIZE];
+};
+
+typedef struct context ctx_s;
+
+static void
+fetch_opts(opts_s *opts, int argc, char **argv)
+{
+	// there can't be more devices than arguments
+	opts->devices = calloc(argc, sizeof(char*));
+
+	opterr = 0;
+	int o;
+	while ((o = getopt(argc, argv, "abd:f:g:hi:kmp:rS:suV")) != -1)
+	{
+		switch (o)
+		{
+			case 'a':
+				opts->total = 1;
+				break;
+			case 'b':
+				opts->binary = 1;
+				break;
+			case 'd':
+				opts->devices[opts->num_devices++] = optarg;
+				break;
+			case 'f':
+				opts->format = optarg;
+				break;
+			case 'g':
+				opts->granularity = tolower(optarg[0]);
+				break;
+			case 'h':
+				opts->help = 1;
+				break;
+			case 'i':
+				opts->interval = atoi(optarg);
+				break;
+			case 'k':
+				opts->continuous = 1;
+				break;
+			case 'm':
+				opts->monitor = 1;
+				break;
+			case 'p':
+				opts->precision = atoi(optarg);
+				break;
+			case 'r':
+				opts->records = 1;
+				break;
+			case 'S':
+				opts->separator = optarg;
+				break;
+			case 's':
+				opts->space = 1;
+				break;
+			case 'u':
+				opts->unit = 1;
+				break;
+			case 'V':
+				opts->version = 1;
+				break;
+		}
+	}
+}
+
+static void
+help(char *invocation, FILE* stream)
+{
+	fprintf(stream, "Usage:\n");
+     	fprintf(stream, "\t%s [OPTION...]\n", invocation);
+	fprintf(stream, "\n");
+	fprintf(stream, "Options:\n");
+	fprintf(stream, "\t-a Add the aggregate over all devices\n");
+	fprintf(stream, "\t-b Use binary instead of decimal units\n");
+	fprintf(stream, "\t-d DEVICE Block device to query (sda, nvme0n1, ...), can be repeated\n");
+	fprintf(stream, "\t-f FORMAT Format string for output, default is '%%u'\n");
+	fprintf(stream, "\t-g GRANULARITY Value granularity (k, m, g, t, p); default is 'm'\n");
+	fprintf(stream, "\t-h Print this help text and exit\n");
+	fprintf(stream, "\t-i INTERVAL Seconds between reading disk stats; default is 1\n");
+	fprintf(stream, "\t-k Keep printing even if the output hasn't changed\n");
+	fprintf(stream, "\t-m Keep running and print when there is a change in output\n");
+	fprintf(stream, "\t-p Number of decimal digits in the output; default is 0\n");
+	fprintf(stream, "\t-r Print one line per device instead of joining them\n");
+	fprintf(stream, "\t-S SEPARATOR String to put between devices (without -r); default is ' '\n");
+	fprintf(stream, "\t-s Print a space between value and unit\n");
+	fprintf(stream, "\t-u Print the appropriate unit after the value\n");
+	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "Format specifiers:\n");
+	fprintf(stream, "\t%%R, %%W, %%T: Bytes read, written, both per second\n");
+	fprintf(stream, "\t%%r, %%w, %%t: Read, write, all I/O operations per second\n");
+	fprintf(stream, "\t%%a: Average time per I/O operation (ms)\n");
+	fprintf(stream, "\t%%u: Utilization (percent of time the device was busy)\n");
+	fprintf(stream, "\t%%n: Device name\n");
+}
+
+/*
+ * Print version information.
+ */
+static void
+version(FILE *stream)
+{
+	fprintf(stream, "%s %d.%d.%d\n%s\n", PROGRAM_NAME,
+			PROGRAM_VER_MAJOR, PROGRAM_VER_MINOR, PROGRAM_VER_PATCH,
+			PROGRAM_URL);
+}
+
+/*
+ * Appends a device to the list and opens its stat file, which is then held
+ * open for the lifetime of the program. If `name` is NULL, the aggregate
+ * is added instead. Returns 0 on success, -1 on error.
+ */
+static int
+add_disk(disks_s *disks, const char *name)
+{
+	disk_s *list = realloc(disks->list, sizeof(disk_s) * (disks->num + 1));
+	if (list == NULL)
+	{
+		return -1;
+	}
+	disks->list = list;
+
+	disk_s *disk = &disks->list[disks->num];
+	*disk = (const disk_s) { .fd = -1 };
+	snprintf(disk->name, NAME_SIZE, "%s", name ? name : DEFAULT_TOTAL_NAME);
+
+	if (name)
+	{
+		char file[STAT_FILE_BUFLEN];
+		snprintf(file, STAT_FILE_BUFLEN, STAT_FILE_FORMAT, DEFAULT_BLOCKDIR, name);
+		if ((disk->fd = open(file, O_RDONLY | O_CLOEXEC)) == -1)
+		{
+			return -1;
+		}
+	}
+
+	++disks->num;
+	return 0;
+}
+
+static void
+free_disks(disks_s *disks)
+{
+	for (size_t i = 0; i < disks->num; ++i)
+	{
+		if (disks->list[i].fd != -1)
+		{
+			close(disks->list[i].fd);
+		}
+	}
+	free(disks->list);
+	disks->list = NULL;
+	disks->num = 0;
+}
+
+/*
+ * Adds all physical disks, which are the block devices that have a `device`
+ * link. This excludes partitions as well as loop, ram, zram, dm and md
+ * devices, which would otherwise count the same I/O multiple times.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+add_physical_disks(disks_s *disks)
+{
+	DIR *dir = opendir(DEFAULT_BLOCKDIR);
+	if (dir == NULL)
+	{
+		return -1;
+	}
+
+	struct dirent *entry = NULL;
+	struct stat st = { 0 };
+	char device[sizeof(entry->d_name) + sizeof("/device")];
+
+	while ((entry = readdir(dir)))
+	{
+		if (entry->d_name[0] == '.')
+		{
+			continue;
+		}
+
+		snprintf(device, sizeof(device), "%s/device", entry->d_name);
+		if (fstatat(dirfd(dir), device, &st, 0) == -1)
+		{
+			continue;
+		}
+
+		if (add_disk(disks, entry->d_name) == -1)
+		{
+			closedir(dir);
+			return -1;
+		}
+	}
+
+	closedir(dir);
+	return 0;
+}
+
+/*
+ * Reads the stat file of the given device (using the held-open descriptor).
+ * Returns 0 on success, -1 on error.
+ */
+static int
+read_stats(disk_s *disk)
+{
+	char buf[STAT_FILE_BUFLEN];
+	ssize_t len = pread(disk->fd, buf, STAT_FILE_BUFLEN - 1, 0);
+	if (len <= 0)
+	{
+		return -1;
+	}
+	buf[len] = '\0';
+
+	stats_s *s = &disk->curr;
+	if (sscanf(buf, "%lu %*u %lu %lu %lu %*u %lu %lu %*u %lu",
+			&s->rd_ios, &s->rd_sectors, &s->rd_ticks,
+			&s->wr_ios, &s->wr_sectors, &s->wr_ticks,
+			&s->io_ticks) != 7)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Turns the difference between the current and previous counters into rates.
+ */
+static void
+calc_info(info_s *info, stats_s *curr, stats_s *prev, int interval)
+{
+	ulong rd_ios = curr->rd_ios - prev->rd_ios;
+	ulong wr_ios = curr->wr_ios - prev->wr_ios;
+	ulong ticks  = (curr->rd_ticks - prev->rd_ticks) + (curr->wr_ticks - prev->wr_ticks);
+
+	info->rd_bytes = ((curr->rd_sectors - prev->rd_sectors) * SECTOR_SIZE) / interval;
+	info->wr_bytes = ((curr->wr_sectors - prev->wr_sectors) * SECTOR_SIZE) / interval;
+	info->tx_bytes = info->rd_bytes + info->wr_bytes;
+
+	info->rd_iops = rd_ios / (double) interval;
+	info->wr_iops = wr_ios / (double) interval;
+	info->tx_iops = info->rd_iops + info->wr_iops;
+
+	info->await = rd_ios + wr_ios ? ticks / (double) (rd_ios + wr_ios) : 0.0;
+	info->util  = ((curr->io_ticks - prev->io_ticks) / (interval * 1000.0)) * 100.0;
+	if (info->util > 100.0)
+	{
+		info->util = 100.0;
+	}
+}
+
+/*
+ * Reads the stats for all devices and calculates their rates. The aggregate,
+ * if any, sums up the counters of all devices, except for the utilization,
+ * for which it reports that of the busiest device. Returns 0 on success, -1
+ * on error.
+ */
+static int
+fetch_info(disks_s *disks, opts_s *opts)
+{
+	disk_s *total = NULL;
+	double util = 0.0;
+
+	for (size_t i = 0; i < disks->num; ++i)
+	{
+		disk_s *disk = &disks->list[i];
+		if (disk->fd == -1)
+		{
+			total = disk;
+			total->curr = (const stats_s) { 0 };
+			continue;
+		}
+
+		if (read_stats(disk) == -1)
+		{
+			return -1;
+		}
+		calc_info(&disk->info, &disk->curr, &disk->prev, opts->interval);
+		disk->prev = disk->curr;
+
+		if (disk->info.util > util)
+		{
+			util = disk->info.util;
+		}
+	}
+
+	if (total == NULL)
+	{
+		return 0;
+	}
+
+	for (size_t i = 0; i < disks->num; ++i)
+	{
+		stats_s *s = &disks->list[i].curr;
+		if (disks->list[i].fd == -1)
+		{
+			continue;
+		}
+		total->curr.rd_ios     += s->rd_ios;
+		total->curr.rd_sectors += s->rd_sectors;
+		total->curr.rd_ticks   += s->rd_ticks;
+		total->curr.wr_ios     += s->wr_ios;
+		total->curr.wr_sectors += s->wr_sectors;
+		total->curr.wr_ticks   += s->wr_ticks;
+	}
+
+	calc_info(&total->info, &total->curr, &total->prev, opts->interval);
+	total->info.util = util;
+	total->prev = total->curr;
+
+	return 0;
+}
+
+static void
+format_abs_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s%s",
+		opts->precision,
+		val / opts->unit_size,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? opts->unit_abbr : "",
+		opts->unit ? "/s" : ""
+	);
+}
+
+static void
+format_value(char *buf, size_t len, double val, const char *unit, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? unit : ""
+	);
+}
+
+static char*
+candy_format_cb(char c, void* context)
+{
+	ctx_s* ctx = (ctx_s*) context;
+
+	switch(c)
+	{
+		case 'R':       // bytes read per second
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->rd_bytes, ctx->opts);
+			return ctx->buffer;
+		case 'W':       // bytes written per second
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->wr_bytes, ctx->opts);
+			return ctx->buffer;
+		case 'T':       // bytes read and written per second
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->tx_bytes, ctx->opts);
+			return ctx->buffer;
+		case 'r':       // read IOPS
+			format_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->rd_iops, "IOPS", ctx->opts);
+			return ctx->buffer;
+		case 'w':       // write IOPS
+			format_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->wr_iops, "IOPS", ctx->opts);
+			return ctx->buffer;
+		case 't':       // read and write IOPS
+			format_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->tx_iops, "IOPS", ctx->opts);
+			return ctx->buffer;
+		case 'a':       // average time per I/O
+			format_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->await, "ms", ctx->opts);
+			return ctx->buffer;
+		case 'u':       // utilization
+			format_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->util, "%", ctx->opts);
+			return ctx->buffer;
+		case 'n':       // device name
+			return ctx->disk->name;
+		default:
+			return NULL;
+	}
+}
+
+static void
+format_info(ctx_s* ctx, disk_s* disk)
+{
+	ctx->info = &disk->info;
+	ctx->disk = disk;
+	candy_format(ctx->opts->format, disk->output_curr, OUTPUT_SIZE, candy_format_cb, ctx);
+}
+
+/*
+ * Prints the output of all devices, either joined into one line or one line
+ * per device. In the latter case, only devices with changed output are
+ * printed, unless `all` is set.
+ */
+static void
+print_disks(disks_s* disks, opts_s* opts, int all)
+{
+	for (size_t i = 0; i < disks->num; ++i)
+	{
+		disk_s *disk = &disks->list[i];
+		if (opts->records && !all && strcmp(disk->output_prev, disk->output_curr) == 0)
+		{
+			continue;
+		}
+		if (opts->records)
+		{
+			fprintf(stdout, "%s\n", disk->output_curr);
+		}
+		else
+		{
+			fprintf(stdout, "%s%s", i ? opts->separator : "", disk->output_curr);
+		}
+	}
+
+	if (!opts->records)
+	{
+		fprintf(stdout, "\n");
+	}
+}
+
+/*
+ * Checks if the output of any of the devices has changed.
+ */
+static int
+output_changed(disks_s* disks)
+{
+	for (size_t i = 0; i < disks->num; ++i)
+	{
+		if (strcmp(disks->list[i].output_prev, disks->list[i].output_curr) != 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Opens the stat files of all devices the user asked for (or of all physical
+ * disks, if none were given) and adds the aggregate, if requested.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+load_disks(opts_s *opts, disks_s *disks)
+{
+	for (size_t i = 0; i < opts->num_devices; ++i)
+	{
+		if (add_disk(disks, opts->devices[i]) == -1)
+		{
+			return -1;
+		}
+	}
+
+	// no devices given means we report the aggregate over all disks
+	if (opts->num_devices == 0)
+	{
+		disks_s all = { 0 };
+		if (add_physical_disks(&all) == -1)
+		{
+			free_disks(&all);
+			return -1;
+		}
+		*disks = all;
+		opts->total = 1;
+	}
+
+	return opts->total ? add_disk(disks, NULL) : 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	opts_s opts = { 0 };
+	fetch_opts(&opts, argc, argv);
+
+	// show help and exit
+	if (opts.help)
+	{
+		help(argv[0], stdout);
+		free(opts.devices);
+		return EXIT_SUCCESS;
+	}
+
+	// show version info and exit
+	if (opts.version)
+	{
+		version(stdout);
+		free(opts.devices);
+		return EXIT_SUCCESS;
+	}
+
+	if (opts.format == NULL)
+	{
+		opts.format = DEFAULT_FORMAT;
+	}
+
+	if (opts.separator == NULL)
+	{
+		opts.separator = DEFAULT_SEPARATOR;
+	}
+
+	if (opts.granularity == 0)
+	{
+		opts.granularity = *DEFAULT_GRANULARITY;
+	}
+
+	// we need some interval, as we need to take two measurements
+	if (opts.interval == 0)
+	{
+		opts.interval = DEFAULT_INTERVAL;
+	}
+
+	// important data structures for processing
+	disks_s disks = { 0 };
+	ctx_s ctx = { .opts = &opts };
+
+	// open the stat files of all devices (only once)
+	if (load_disks(&opts, &disks) == -1)
+	{
+		free_disks(&disks);
+		free(opts.devices);
+		return EXIT_FAILURE;
+	}
+
+	// when showing only the aggregate, there is no point in the individual
+	// devices being printed; we keep them around for reading, though
+	size_t first = opts.num_devices == 0 ? disks.num - 1 : 0;
+	disks_s shown = { .list = disks.list + first, .num = disks.num - first };
+
+	// ensure stdout is line buffered
+	setlinebuf(stdout);
+
+	// set additional members of the opts struct based on the granularity
+	candy_unit_info(opts.granularity, opts.binary, &opts.unit_size, &opts.unit_abbr);
+
+	// initial read, so we have something to calculate the difference with
+	if (fetch_info(&disks, &opts) == -1)
+	{
+		free_disks(&disks);
+		free(opts.devices);
+		return EXIT_FAILURE;
+	}
+
+	do
+	{
+		sleep(opts.interval);
+
+		// fetch the disk stats and calculate the rates
+		if (fetch_info(&disks, &opts) == -1)
+		{
+			free_disks(&disks);
+			free(opts.devices);
+			return EXIT_FAILURE;
+		}
+
+		// formulate the output strings based on opts->format
+		for (size_t i = 0; i < shown.num; ++i)
+		{
+			format_info(&ctx, &shown.list[i]);
+		}
+
+		// print
+		if (opts.continuous || output_changed(&shown))
+		{
+			print_disks(&shown, &opts, opts.continuous);
+		}
+
+		// update values for next iteration
+		for (size_t i = 0; i < shown.num; ++i)
+		{
+			strcpy(shown.list[i].output_prev, shown.list[i].output_curr);
+		}
+	}
+	while (opts.monitor);
+
+	free_disks(&disks);
+	free(opts.devices);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,787 @@
+#include <stdio.h>            // fprintf
+#include <stdlib.h>           // NULL, EXIT_*
+#include <unistd.h>           // getopt() et al., read(), close()
+#include <ctype.h>            // tolower(), isdigit()
+#include <string.h>           // strcpy(), strcmp(), strstr()
+#include <fcntl.h>            // open(), openat()
+#include <dirent.h>           // fdopendir(), readdir(), rewinddir()
+#include <time.h>             // clock_gettime()
+#include <sys/types.h>        // pid_t
+
+#define CANDIES_API static
+#include "candies.h"
+
+#define PROGRAM_NAME "io-proc"
+#define PROGRAM_URL  "https://github.com/domsson/candies/io-proc"
+
+#define PROGRAM_VER_MAJOR 0
+#define PROGRAM_VER_MINOR 1
+#define PROGRAM_VER_PATCH 0
+
+#define DEFAULT_INTERVAL     1
+#define DEFAULT_GRANULARITY "k"
+#define DEFAULT_FORMAT      "%W"
+#define DEFAULT_SEPARATOR   " "
+#define DEFAULT_PROCDIR     "/proc"
+
+#define IO_FILE_BUFLEN 512
+#define MAP_SIZE       1024    // initial number of slots, power of two
+
+#define NAME_SIZE   32
+#define COMM_LEN    15         // the kernel truncates `comm` to this length
+#define OUTPUT_SIZE 128
+#define RESULT_SIZE 24
+
+typedef unsigned long ulong;
+typedef unsigned char byte;
+
+// Previous counters of one process, as stored in the map
+struct entry
+{
+	pid_t pid;           // 0 marks an empty slot
+	ulong rd_bytes;      // read_bytes from /proc/[pid]/io
+	ulong wr_bytes;      // write_bytes from /proc/[pid]/io
+};
+
+typedef struct entry entry_s;
+
+// Hash map from pid to counters (open addressing, linear probing). There is
+// one for the previous and one for the current sample, which are swapped on
+// every tick, so that processes which are gone simply don't make it over.
+struct map
+{
+	entry_s *slots;
+	size_t size;         // number of slots, power of two
+	size_t num;          // number of slots in use
+};
+
+typedef struct map map_s;
+
+struct info
+{
+	double rd_bytes;     // bytes read per second
+	double wr_bytes;     // bytes written per second
+	double tx_bytes;     // bytes read and written per second
+};
+
+typedef struct info info_s;
+
+struct proc
+{
+	pid_t pid;
+	char name[NAME_SIZE];
+	size_t count;        // number of processes that make up `info`
+	info_s info;
+	char output_prev[OUTPUT_SIZE];
+	char output_curr[OUTPUT_SIZE];
+};
+
+typedef struct proc proc_s;
+
+struct procs
+{
+	proc_s *list;
+	size_t num;          // number of processes currently shown
+	size_t size;         // capacity of `list`
+	proc_s *all;         // scratch space for finding the top processes
+	size_t all_size;     // capacity of `all`
+};
+
+typedef struct procs procs_s;
+
+struct opts
+{
+	byte help : 1;       // show help and exit
+	byte version : 1;    // show version info and exit
+	byte monitor : 1;    // keep running and printing
+	byte unit : 1;       // print a unit character
+	byte space : 1;      // print a space between value and unit
+	byte binary : 1;     // binary instead of decimal units (MiB vs MB etc)
+	byte continuous : 1; // continously print, even if no change in value
+	byte records : 1;    // print one line per process instead of joining them
+	int interval;        // interval, in seconds, to sample the counters
+	int precision;       // number of decimals in output
+	pid_t pid;           // process of interest (pid mode)
+	char *name;          // name of the processes of interest (name mode)
+	int top;             // number of top writers (top mode)
+	char *separator;     // separator between processes (if not `records`)
+	char *format;
+	char granularity;    // unit granularity (m = mega, g = giga, etc)
+
+	ulong unit_size;     // will be set by program
+	char *unit_abbr;     // will be set by program
+};
+
+typedef struct opts opts_s;
+
+struct context
+{
+	opts_s* opts;
+	proc_s* proc;
+	char buffer[RESULT_SIZE];
+};
+
+typedef struct context ctx_s;
+
+static void
+fetch_opts(opts_s *opts, int argc, char **argv)
+{
+	opterr = 0;
+	int o;
+	while ((o = getopt(argc, argv, "bf:g:hi:kmn:P:p:rS:st:uV")) != -1)
+	{
+		switch (o)
+		{
+			case 'b':
+				opts->binary = 1;
+				break;
+			case 'f':
+				opts->format = optarg;
+				break;
+			case 'g':
+				opts->granularity = tolower(optarg[0]);
+				break;
+			case 'h':
+				opts->help = 1;
+				break;
+			case 'i':
+				opts->interval = atoi(optarg);
+				break;
+			case 'k':
+				opts->continuous = 1;
+				break;
+			case 'm':
+				opts->monitor = 1;
+				break;
+			case 'n':
+				opts->name = optarg;
+				break;
+			case 'P':
+				opts->pid = atoi(optarg);
+				break;
+			case 'p':
+				opts->precision = atoi(optarg);
+				break;
+			case 'r':
+				opts->records = 1;
+				break;
+			case 'S':
+				opts->separator = optarg;
+				break;
+			case 's':
+				opts->space = 1;
+				break;
+			case 't':
+				opts->top = atoi(optarg);
+				break;
+			case 'u':
+				opts->unit = 1;
+				break;
+			case 'V':
+				opts->version = 1;
+				break;
+		}
+	}
+}
+
+static void
+help(char *invocation, FILE* stream)
+{
+	fprintf(stream, "Usage:\n");
+	fprintf(stream, "\t%s [OPTION...]\n", invocation);
+	fprintf(stream, "\n");
+	fprintf(stream, "Options:\n");
+	fprintf(stream, "\t-b Use binary instead of decimal units\n");
+	fprintf(stream, "\t-f FORMAT Format string for output, default is '%%W'\n");
+	fprintf(stream, "\t-g GRANULARITY Value granularity (k, m, g, t, p); default is 'k'\n");
+	fprintf(stream, "\t-h Print this help text and exit\n");
+	fprintf(stream, "\t-i INTERVAL Seconds between sampling the counters; default is 1\n");
+	fprintf(stream, "\t-k Keep printing even if the output hasn't changed\n");
+	fprintf(stream, "\t-m Keep running and print when there is a change in output\n");
+	fprintf(stream, "\t-n NAME Report the sum over all processes with this name (first 15 characters)\n");
+	fprintf(stream, "\t-P PID Report the process with this PID\n");
+	fprintf(stream, "\t-p Number of decimal digits in the output; default is 0\n");
+	fprintf(stream, "\t-r Print one line per process instead of joining them\n");
+	fprintf(stream, "\t-S SEPARATOR String to put between processes (without -r); default is ' '\n");
+	fprintf(stream, "\t-s Print a space between value and unit\n");
+	fprintf(stream, "\t-t NUMBER Report the NUMBER processes writing the most\n");
+	fprintf(stream, "\t-u Print the appropriate unit after the value\n");
+	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "Format specifiers:\n");
+	fprintf(stream, "\t%%R, %%W, %%T: Bytes read, written, both per second\n");
+	fprintf(stream, "\t%%n: Process name\n");
+	fprintf(stream, "\t%%P: Process ID\n");
+	fprintf(stream, "\t%%c: Number of processes (with -n)\n");
+}
+
+/*
+ * Print version information.
+ */
+static void
+version(FILE *stream)
+{
+	fprintf(stream, "%s %d.%d.%d\n%s\n", PROGRAM_NAME,
+			PROGRAM_VER_MAJOR, PROGRAM_VER_MINOR, PROGRAM_VER_PATCH,
+			PROGRAM_URL);
+}
+
+static double
+get_time()
+{
+	struct timespec ts = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+static int
+map_init(map_s *map, size_t size)
+{
+	map->slots = calloc(size, sizeof(entry_s));
+	map->size = size;
+	map->num = 0;
+	return map->slots ? 0 : -1;
+}
+
+static void
+map_clear(map_s *map)
+{
+	memset(map->slots, 0, map->size * sizeof(entry_s));
+	map->num = 0;
+}
+
+static entry_s*
+map_slot(map_s *map, pid_t pid)
+{
+	size_t i = ((ulong) pid * 2654435761UL) & (map->size - 1);
+	while (map->slots[i].pid && map->slots[i].pid != pid)
+	{
+		i = (i + 1) & (map->size - 1);
+	}
+	return &map->slots[i];
+}
+
+static entry_s*
+map_find(map_s *map, pid_t pid)
+{
+	entry_s *entry = map_slot(map, pid);
+	return entry->pid ? entry : NULL;
+}
+
+/*
+ * Doubles the number of slots. Returns 0 on success, -1 on error.
+ */
+static int
+map_grow(map_s *map)
+{
+	map_s grown = { 0 };
+	if (map_init(&grown, map->size * 2) == -1)
+	{
+		return -1;
+	}
+	for (size_t i = 0; i < map->size; ++i)
+	{
+		if (map->slots[i].pid)
+		{
+			*map_slot(&grown, map->slots[i].pid) = map->slots[i];
+		}
+	}
+	grown.num = map->num;
+	free(map->slots);
+	*map = grown;
+	return 0;
+}
+
+/*
+ * Stores the counters of the given process, keeping the map at most half
+ * full. Returns 0 on success, -1 on error.
+ */
+static int
+map_put(map_s *map, const entry_s *entry)
+{
+	if ((map->num + 1) * 2 > map->size && map_grow(map) == -1)
+	{
+		return -1;
+	}
+	entry_s *slot = map_slot(map, entry->pid);
+	if (slot->pid == 0)
+	{
+		++map->num;
+	}
+	*slot = *entry;
+	return 0;
+}
+
+/*
+ * Reads a small file relative to the /proc dirfd into `buf`.
+ * Returns the number of bytes read, or -1 on error.
+ */
+static ssize_t
+read_proc_file(int dirfd, pid_t pid, const char *file, char *buf, size_t len)
+{
+	char path[NAME_SIZE];
+	snprintf(path, NAME_SIZE, "%d/%s", pid, file);
+
+	int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		return -1;
+	}
+	ssize_t n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+	{
+		return -1;
+	}
+	buf[n] = '\0';
+	return n;
+}
+
+/*
+ * Reads the name of the given process into `name` (NAME_SIZE).
+ * Returns 0 on success, -1 on error.
+ */
+static int
+read_name(int dirfd, pid_t pid, char *name)
+{
+	ssize_t n = read_proc_file(dirfd, pid, "comm", name, NAME_SIZE);
+	if (n == -1)
+	{
+		return -1;
+	}
+	name[strcspn(name, "\n")] = '\0';
+	return 0;
+}
+
+/*
+ * Reads the I/O counters of the given process into `entry`. This only works
+ * for processes of the same user, unless running as root.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+read_io(int dirfd, pid_t pid, entry_s *entry)
+{
+	char buf[IO_FILE_BUFLEN];
+	if (read_proc_file(dirfd, pid, "io", buf, IO_FILE_BUFLEN) == -1)
+	{
+		return -1;
+	}
+
+	char *rd = strstr(buf, "\nread_bytes:");
+	char *wr = strstr(buf, "\nwrite_bytes:");
+	if (rd == NULL || wr == NULL)
+	{
+		return -1;
+	}
+
+	entry->pid = pid;
+	entry->rd_bytes = strtoul(rd + sizeof("\nread_bytes:") - 1, NULL, 10);
+	entry->wr_bytes = strtoul(wr + sizeof("\nwrite_bytes:") - 1, NULL, 10);
+	return 0;
+}
+
+/*
+ * Samples the given process, stores its counters in `curr` and, if it was
+ * also found in `prev`, calculates its rates over `elapsed` seconds.
+ * Returns 1 if rates were calculated, 0 if not, -1 on error.
+ */
+static int
+sample(int dirfd, pid_t pid, map_s *curr, map_s *prev, double elapsed, info_s *info)
+{
+	entry_s entry = { 0 };
+	if (read_io(dirfd, pid, &entry) == -1 || map_put(curr, &entry) == -1)
+	{
+		return -1;
+	}
+
+	entry_s *last = map_find(prev, pid);
+	if (last == NULL || elapsed <= 0.0)
+	{
+		return 0;
+	}
+
+	// counters never go backwards, unless the pid has been reused
+	if (entry.rd_bytes < last->rd_bytes || entry.wr_bytes < last->wr_bytes)
+	{
+		return 0;
+	}
+
+	info->rd_bytes = (entry.rd_bytes - last->rd_bytes) / elapsed;
+	info->wr_bytes = (entry.wr_bytes - last->wr_bytes) / elapsed;
+	info->tx_bytes = info->rd_bytes + info->wr_bytes;
+	return 1;
+}
+
+/*
+ * Makes sure `all` can hold at least `num` processes.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+reserve_all(procs_s *procs, size_t num)
+{
+	if (num <= procs->all_size)
+	{
+		return 0;
+	}
+	size_t size = num * 2;
+	proc_s *all = realloc(procs->all, size * sizeof(proc_s));
+	if (all == NULL)
+	{
+		return -1;
+	}
+	procs->all = all;
+	procs->all_size = size;
+	return 0;
+}
+
+static int
+compare_writes(const void* a, const void* b)
+{
+	const info_s *ia = &((const proc_s*) a)->info;
+	const info_s *ib = &((const proc_s*) b)->info;
+	if (ia->wr_bytes != ib->wr_bytes)
+	{
+		return (ia->wr_bytes < ib->wr_bytes) - (ia->wr_bytes > ib->wr_bytes);
+	}
+	return (ia->rd_bytes < ib->rd_bytes) - (ia->rd_bytes > ib->rd_bytes);
+}
+
+/*
+ * Samples all processes of interest, depending on the mode: a single PID, all
+ * processes with a given name, or all processes (to find the top writers).
+ * Returns 0 on success, -1 on error.
+ */
+static int
+fetch_info(DIR *dir, map_s *curr, map_s *prev, procs_s *procs, opts_s *opts, double elapsed)
+{
+	int procfd = dirfd(dir);
+
+	// pid mode: a single process, which has to exist
+	if (opts->pid)
+	{
+		proc_s *proc = &procs->list[0];
+		proc->info = (const info_s) { 0 };
+		if (sample(procfd, opts->pid, curr, prev, elapsed, &proc->info) == -1 ||
+				read_name(procfd, opts->pid, proc->name) == -1)
+		{
+			return -1;
+		}
+		proc->pid = opts->pid;
+		proc->count = 1;
+		procs->num = 1;
+		return 0;
+	}
+
+	// name mode: one result, summed over all matching processes
+	proc_s *sum = &procs->list[0];
+	if (opts->name)
+	{
+		sum->info  = (const info_s) { 0 };
+		sum->count = 0;
+		sum->pid   = 0;
+		snprintf(sum->name, NAME_SIZE, "%s", opts->name);
+		procs->num = 1;
+	}
+
+	struct dirent *de = NULL;
+	size_t num = 0;
+	rewinddir(dir);
+	while ((de = readdir(dir)))
+	{
+		if (!isdigit(de->d_name[0]))
+		{
+			continue;
+		}
+		pid_t pid = atoi(de->d_name);
+
+		if (opts->name)
+		{
+			char name[NAME_SIZE];
+			info_s info = { 0 };
+			// `comm` is truncated, so only compare as much of the name
+			if (read_name(procfd, pid, name) == -1 || strncmp(name, opts->name, COMM_LEN) != 0 ||
+					sample(procfd, pid, curr, prev, elapsed, &info) == -1)
+			{
+				continue;
+			}
+			sum->info.rd_bytes += info.rd_bytes;
+			sum->info.wr_bytes += info.wr_bytes;
+			sum->info.tx_bytes += info.tx_bytes;
+			sum->count += 1;
+			sum->pid = pid;
+			continue;
+		}
+
+		// top mode: remember all processes for now, the names come later
+		if (reserve_all(procs, num + 1) == -1)
+		{
+			return -1;
+		}
+		proc_s *proc = &procs->all[num];
+		proc->info = (const info_s) { 0 };
+		if (sample(procfd, pid, curr, prev, elapsed, &proc->info) == 1)
+		{
+			proc->pid = pid;
+			++num;
+		}
+	}
+
+	if (opts->name)
+	{
+		return 0;
+	}
+
+	// top mode: pick the top writers and only look up their names
+	qsort(procs->all, num, sizeof(proc_s), compare_writes);
+	procs->num = 0;
+	for (size_t i = 0; i < num && procs->num < procs->size; ++i)
+	{
+		proc_s *proc = &procs->list[procs->num];
+		if (read_name(procfd, procs->all[i].pid, proc->name) == -1)
+		{
+			continue;
+		}
+		proc->pid   = procs->all[i].pid;
+		proc->info  = procs->all[i].info;
+		proc->count = 1;
+		++procs->num;
+	}
+	return 0;
+}
+
+static void
+format_abs_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s%s",
+		opts->precision,
+		val / opts->unit_size,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? opts->unit_abbr : "",
+		opts->unit ? "/s" : ""
+	);
+}
+
+static char*
+candy_format_cb(char c, void* context)
+{
+	ctx_s* ctx = (ctx_s*) context;
+
+	switch(c)
+	{
+		case 'R':       // bytes read per second
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->proc->info.rd_bytes, ctx->opts);
+			return ctx->buffer;
+		case 'W':       // bytes written per second
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->proc->info.wr_bytes, ctx->opts);
+			return ctx->buffer;
+		case 'T':       // bytes read and written per second
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->proc->info.tx_bytes, ctx->opts);
+			return ctx->buffer;
+		case 'n':       // process name
+			return ctx->proc->name;
+		case 'P':       // process id
+			snprintf(ctx->buffer, RESULT_SIZE, "%d", ctx->proc->pid);
+			return ctx->buffer;
+		case 'c':       // number of processes
+			snprintf(ctx->buffer, RESULT_SIZE, "%zu", ctx->proc->count);
+			return ctx->buffer;
+		default:
+			return NULL;
+	}
+}
+
+static void
+format_info(ctx_s* ctx, proc_s* proc)
+{
+	ctx->proc = proc;
+	candy_format(ctx->opts->format, proc->output_curr, OUTPUT_SIZE, candy_format_cb, ctx);
+}
+
+/*
+ * Prints the output of all processes, either joined into one line or one
+ * line per process.
+ */
+static void
+print_procs(procs_s* procs, opts_s* opts)
+{
+	for (size_t i = 0; i < procs->num; ++i)
+	{
+		if (opts->records)
+		{
+			fprintf(stdout, "%s\n", procs->list[i].output_curr);
+		}
+		else
+		{
+			fprintf(stdout, "%s%s", i ? opts->separator : "", procs->list[i].output_curr);
+		}
+	}
+
+	if (!opts->records)
+	{
+		fprintf(stdout, "\n");
+	}
+}
+
+/*
+ * Checks if the output of any of the processes has changed.
+ */
+static int
+output_changed(procs_s* procs)
+{
+	for (size_t i = 0; i < procs->size; ++i)
+	{
+		if (strcmp(procs->list[i].output_prev, procs->list[i].output_curr) != 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void
+free_all(DIR *dir, map_s *curr, map_s *prev, procs_s *procs)
+{
+	if (dir)
+	{
+		closedir(dir);
+	}
+	free(curr->slots);
+	free(prev->slots);
+	free(procs->list);
+	free(procs->all);
+}
+
+int
+main(int argc, char **argv)
+{
+	opts_s opts = { 0 };
+	fetch_opts(&opts, argc, argv);
+
+	// show help and exit
+	if (opts.help)
+	{
+		help(argv[0], stdout);
+		return EXIT_SUCCESS;
+	}
+
+	// show version info and exit
+	if (opts.version)
+	{
+		version(stdout);
+		return EXIT_SUCCESS;
+	}
+
+	// exactly one mode has to be given
+	if ((opts.pid > 0) + (opts.name != NULL) + (opts.top > 0) != 1)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if (opts.format == NULL)
+	{
+		opts.format = DEFAULT_FORMAT;
+	}
+
+	if (opts.separator == NULL)
+	{
+		opts.separator = DEFAULT_SEPARATOR;
+	}
+
+	if (opts.granularity == 0)
+	{
+		opts.granularity = *DEFAULT_GRANULARITY;
+	}
+
+	// we need some interval, as we need to take two measurements
+	if (opts.interval == 0)
+	{
+		opts.interval = DEFAULT_INTERVAL;
+	}
+
+	// ensure stdout is line buffered
+	setlinebuf(stdout);
+
+	// set additional members of the opts struct based on the granularity
+	candy_unit_info(opts.granularity, opts.binary, &opts.unit_size, &opts.unit_abbr);
+
+	// important data structures for processing; /proc stays open throughout
+	int fd = open(DEFAULT_PROCDIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	DIR *dir = fd == -1 ? NULL : fdopendir(fd);
+	map_s curr = { 0 };
+	map_s prev = { 0 };
+	procs_s procs = { .size = opts.top ? opts.top : 1 };
+	procs.list = calloc(procs.size, sizeof(proc_s));
+	ctx_s ctx = { .opts = &opts };
+
+	if (dir == NULL || procs.list == NULL ||
+			map_init(&curr, MAP_SIZE) == -1 || map_init(&prev, MAP_SIZE) == -1)
+	{
+		if (dir == NULL && fd != -1)
+		{
+			close(fd);
+		}
+		free_all(dir, &curr, &prev, &procs);
+		return EXIT_FAILURE;
+	}
+
+	// initial sample, so we have something to calculate the difference with
+	double t_prev = get_time();
+	if (fetch_info(dir, &curr, &prev, &procs, &opts, 0.0) == -1)
+	{
+		free_all(dir, &curr, &prev, &procs);
+		return EXIT_FAILURE;
+	}
+
+	do
+	{
+		sleep(opts.interval);
+
+		// the current sample becomes the previous one
+		map_s tmp = prev;
+		prev = curr;
+		curr = tmp;
+		map_clear(&curr);
+
+		// sample the processes and calculate the rates
+		double t_curr = get_time();
+		if (fetch_info(dir, &curr, &prev, &procs, &opts, t_curr - t_prev) == -1)
+		{
+			free_all(dir, &curr, &prev, &procs);
+			return EXIT_FAILURE;
+		}
+		t_prev = t_curr;
+
+		// formulate the output strings based on opts->format; slots that
+		// aren't shown get an empty output, so a change in number shows
+		for (size_t i = 0; i < procs.size; ++i)
+		{
+			if (i < procs.num)
+			{
+				format_info(&ctx, &procs.list[i]);
+			}
+			else
+			{
+				procs.list[i].output_curr[0] = '\0';
+			}
+		}
+
+		// print
+		if (opts.continuous || output_changed(&procs))
+		{
+			print_procs(&procs, &opts);
+		}
+
+		// update values for next iteration
+		for (size_t i = 0; i < procs.size; ++i)
+		{
+			strcpy(procs.list[i].output_prev, procs.list[i].output_curr);
+		}
+	}
+	while (opts.monitor);
+
+	free_all(dir, &curr, &prev, &procs);
+	return EXIT_SUCCESS;
+}
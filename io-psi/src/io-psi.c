@@ -0,0 +1,431 @@
+#include <stdio.h>            // fprintf(), sscanf()
+#include <stdlib.h>           // NULL, EXIT_*
+#include <unistd.h>           // getopt() et al., pread(), write(), close()
+#include <string.h>           // strcmp(), strcpy(), strstr()
+#include <fcntl.h>            // open()
+#include <poll.h>             // poll()
+
+#define CANDIES_API static
+#include "candies.h"
+
+#define PROGRAM_NAME "io-psi"
+#define PROGRAM_URL  "https://github.com/domsson/candies/io-psi"
+
+#define PROGRAM_VER_MAJOR 0
+#define PROGRAM_VER_MINOR 1
+#define PROGRAM_VER_PATCH 0
+
+#define DEFAULT_INTERVAL   2
+#define DEFAULT_WINDOW     2000
+#define DEFAULT_FORMAT    "%a"
+
+#define PSI_FILE "/proc/pressure/io"
+
+#define PSI_BUFLEN     256
+#define TRIGGER_BUFLEN 64
+
+#define OUTPUT_SIZE 128
+#define RESULT_SIZE 24
+
+typedef unsigned long ulong;
+typedef unsigned char byte;
+
+// One line of the pressure file: the share of time (in percent) in which
+// some or all (full) non-idle tasks were stalled on I/O, averaged over 10,
+// 60 and 300 seconds, as well as the total stall time in microseconds
+struct pressure
+{
+	double avg10;
+	double avg60;
+	double avg300;
+	ulong total;
+};
+
+typedef struct pressure pressure_s;
+
+struct info
+{
+	pressure_s some;
+	pressure_s full;
+	ulong events;        // number of times the trigger fired
+};
+
+typedef struct info info_s;
+
+struct options
+{
+	byte monitor : 1;    // keep running and printing
+	byte continuous : 1; // keep printing, even if the output didn't change
+	byte unit : 1;       // also print the unit
+	byte space : 1;      // space between val and unit
+	byte full : 1;       // trigger on full instead of some stall time
+	byte help : 1;       // show help and exit
+	byte version : 1;    // show version info and exit
+	int interval;        // print every `interval` seconds
+	int precision;       // decimal places in output
+	int threshold;       // stall time (ms) per window that fires the trigger
+	int window;          // trigger window (ms)
+	char *format;        // format string
+};
+
+typedef struct options opts_s;
+
+struct context
+{
+	info_s *info;
+	opts_s *opts;
+	char buffer[RESULT_SIZE];
+	char output_prev[OUTPUT_SIZE];
+	char output[OUTPUT_SIZE];
+};
+
+typedef struct context ctx_s;
+
+static void
+fetch_opts(opts_s *opts, int argc, char **argv)
+{
+	opterr = 0;
+	int o;
+	while ((o = getopt(argc, argv, "Ff:hi:kmp:st:uVw:")) != -1)
+	{
+		switch (o)
+		{
+			case 'F':
+				opts->full = 1;
+				break;
+			case 'f':
+				opts->format = optarg;
+				break;
+			case 'h':
+				opts->help = 1;
+				break;
+			case 'i':
+				opts->interval = atoi(optarg);
+				break;
+			case 'k':
+				opts->continuous = 1;
+				break;
+			case 'm':
+				opts->monitor = 1;
+				break;
+			case 'p':
+				opts->precision = atoi(optarg);
+				break;
+			case 's':
+				opts->space = 1;
+				break;
+			case 't':
+				opts->threshold = atoi(optarg);
+				break;
+			case 'u':
+				opts->unit = 1;
+				break;
+			case 'V':
+				opts->version = 1;
+				break;
+			case 'w':
+				opts->window = atoi(optarg);
+				break;
+		}
+	}
+}
+
+/**
+ * Prints usage information.
+ */
+static void
+help(char *invocation, FILE* stream)
+{
+	fprintf(stream, "Usage:\n");
+	fprintf(stream, "\t%s [OPTIONS...]\n", invocation);
+	fprintf(stream, "\n");
+	fprintf(stream, "Options:\n");
+	fprintf(stream, "\t-F Trigger on full instead of some stall time (with -t)\n");
+	fprintf(stream, "\t-f Output format string; default is '%%a'\n");
+	fprintf(stream, "\t-h Print this help text and exit\n");
+	fprintf(stream, "\t-i Seconds between checking for a change in value; default is 2\n");
+	fprintf(stream, "\t-k Keep printing, even if the values haven't changed\n");
+	fprintf(stream, "\t-m Keep running and print when there is a change in value\n");
+	fprintf(stream, "\t-p Number of decimal digits in the output; default is 0\n");
+	fprintf(stream, "\t-s Print a space between value and unit\n");
+	fprintf(stream, "\t-t Stall time (ms) per window that wakes us up, instead of -i\n");
+	fprintf(stream, "\t-u Print the appropriate unit after the value\n");
+	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\t-w Trigger window (ms), from 500 to 10000; default is 2000\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "Format specifiers:\n");
+	fprintf(stream, "\t%%a, %%b, %%c: Some tasks stalled, avg. over 10, 60, 300 s (percent)\n");
+	fprintf(stream, "\t%%A, %%B, %%C: All tasks stalled, avg. over 10, 60, 300 s (percent)\n");
+	fprintf(stream, "\t%%t, %%T: Total time some, all tasks stalled (ms)\n");
+	fprintf(stream, "\t%%e: Number of times the trigger fired\n");
+}
+
+/*
+ * Print version information.
+ */
+static void
+version(FILE *stream)
+{
+	fprintf(stream, "%s %d.%d.%d\n%s\n", PROGRAM_NAME,
+			PROGRAM_VER_MAJOR, PROGRAM_VER_MINOR, PROGRAM_VER_PATCH,
+			PROGRAM_URL);
+}
+
+/*
+ * Opens the pressure file and, if a threshold was given, arms a trigger on
+ * it. The trigger stays active for as long as the file is open. Returns the
+ * file descriptor on success, -1 on error (like no PSI support or, for the
+ * trigger, insufficient privileges).
+ */
+static int
+open_psi(opts_s *opts)
+{
+	if (opts->threshold <= 0)
+	{
+		return open(PSI_FILE, O_RDONLY | O_CLOEXEC);
+	}
+
+	int fd = open(PSI_FILE, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd == -1)
+	{
+		return -1;
+	}
+
+	// "<some|full> <stall time> <window>", both in microseconds, including
+	// the terminating null byte
+	char trigger[TRIGGER_BUFLEN];
+	int len = snprintf(trigger, TRIGGER_BUFLEN, "%s %d %d",
+			opts->full ? "full" : "some",
+			opts->threshold * 1000, opts->window * 1000);
+	if (write(fd, trigger, len + 1) == -1)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Waits for the trigger to fire, for at most `timeout` seconds (-1 for no
+ * timeout). Returns 1 if it fired, 0 on timeout and -1 on error.
+ */
+static int
+wait_trigger(int fd, int timeout)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLPRI };
+	int ret = poll(&pfd, 1, timeout == -1 ? -1 : timeout * 1000);
+	if (ret <= 0)
+	{
+		return ret;
+	}
+	return pfd.revents & POLLERR ? -1 : 1;
+}
+
+static int
+parse_pressure(const char *buf, const char *type, pressure_s *p)
+{
+	const char *line = strstr(buf, type);
+	if (line == NULL)
+	{
+		return -1;
+	}
+	return sscanf(line + strlen(type), " avg10=%lf avg60=%lf avg300=%lf total=%lu",
+			&p->avg10, &p->avg60, &p->avg300, &p->total) == 4 ? 0 : -1;
+}
+
+/*
+ * Re-reads the (held-open) pressure file. Returns 0 on success, -1 on error.
+ */
+static int
+fetch_info(int fd, info_s *info)
+{
+	char buf[PSI_BUFLEN];
+	ssize_t len = pread(fd, buf, PSI_BUFLEN - 1, 0);
+	if (len <= 0)
+	{
+		return -1;
+	}
+	buf[len] = '\0';
+
+	if (parse_pressure(buf, "some", &info->some) == -1)
+	{
+		return -1;
+	}
+
+	// kernels before 5.13 don't have the full line for all resources
+	if (parse_pressure(buf, "full", &info->full) == -1)
+	{
+		info->full = (const pressure_s) { 0 };
+	}
+	return 0;
+}
+
+static void
+format_rel_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? "%" : ""
+	);
+}
+
+static void
+format_time_value(char *buf, size_t len, ulong val, opts_s* opts)
+{
+	snprintf(buf, len, "%lu%s%s",
+		val / 1000,
+		opts->space && opts->unit ? " " : "",
+		opts->unit ? "ms" : ""
+	);
+}
+
+static char*
+candy_format_cb(char c, void* context)
+{
+	ctx_s* ctx = (ctx_s*) context;
+
+	switch (c)
+	{
+		case 'a': // some, avg10
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->some.avg10, ctx->opts);
+			return ctx->buffer;
+		case 'b': // some, avg60
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->some.avg60, ctx->opts);
+			return ctx->buffer;
+		case 'c': // some, avg300
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->some.avg300, ctx->opts);
+			return ctx->buffer;
+		case 'A': // full, avg10
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->full.avg10, ctx->opts);
+			return ctx->buffer;
+		case 'B': // full, avg60
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->full.avg60, ctx->opts);
+			return ctx->buffer;
+		case 'C': // full, avg300
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->full.avg300, ctx->opts);
+			return ctx->buffer;
+		case 't': // some, total
+			format_time_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->some.total, ctx->opts);
+			return ctx->buffer;
+		case 'T': // full, total
+			format_time_value(ctx->buffer, RESULT_SIZE,
+					ctx->info->full.total, ctx->opts);
+			return ctx->buffer;
+		case 'e': // trigger events
+			snprintf(ctx->buffer, RESULT_SIZE, "%lu", ctx->info->events);
+			return ctx->buffer;
+		default:
+			return NULL;
+	}
+}
+
+static void
+format_info(ctx_s* ctx)
+{
+	candy_format(ctx->opts->format, ctx->output, OUTPUT_SIZE, candy_format_cb, ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+	opts_s opts = { 0 };
+	fetch_opts(&opts, argc, argv);
+
+	if (opts.help)
+	{
+		help(argv[0], stdout);
+		return EXIT_SUCCESS;
+	}
+
+	if (opts.version)
+	{
+		version(stdout);
+		return EXIT_SUCCESS;
+	}
+
+	if (opts.interval == 0)
+	{
+		opts.interval = DEFAULT_INTERVAL;
+	}
+
+	if (opts.window == 0)
+	{
+		opts.window = DEFAULT_WINDOW;
+	}
+
+	// if not format given, use the default
+	if (opts.format == NULL)
+	{
+		opts.format = DEFAULT_FORMAT;
+	}
+
+	// a trigger only makes sense if we keep running, and so does waiting
+	if (opts.monitor == 0)
+	{
+		opts.threshold = 0;
+		opts.interval = 0;
+	}
+
+	// the file is opened once and then re-read on every iteration
+	int fd = open_psi(&opts);
+	if (fd == -1)
+	{
+		return EXIT_FAILURE;
+	}
+
+	// make sure stdout is line buffered
+	setlinebuf(stdout);
+
+	// data structures we'll need from here on out
+	info_s info = { 0 };
+	ctx_s ctx = { .info = &info, .opts = &opts };
+	int alert = 0;
+
+	do
+	{
+		if (fetch_info(fd, &info) == -1)
+		{
+			close(fd);
+			return EXIT_FAILURE;
+		}
+
+		format_info(&ctx);
+		if (opts.continuous || strcmp(ctx.output, ctx.output_prev) != 0)
+		{
+			fprintf(stdout, "%s\n", ctx.output);
+			strcpy(ctx.output_prev, ctx.output);
+		}
+
+		if (opts.threshold <= 0)
+		{
+			// sleep, maybe (if interval > 0)
+			sleep(opts.interval);
+		}
+		else
+		{
+			// sleep until the trigger fires; while it keeps firing, also 
+			// wake up every interval, so the values going back down get 
+			// printed
+			alert = wait_trigger(fd, alert ? opts.interval : -1);
+			if (alert == -1)
+			{
+				close(fd);
+				return EXIT_FAILURE;
+			}
+			info.events += alert;
+		}
+	}
+	while (opts.monitor);
+
+	close(fd);
+	return EXIT_SUCCESS;
+}
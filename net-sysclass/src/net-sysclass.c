@@ -3,6 +3,18 @@
 #include <unistd.h>           // getopt() et al., access()
 #include <string.h>           // strtok()
 #include <ctype.h>            // tolower()
+#include <errno.h>            // errno
+#include <poll.h>             // poll()
+#include <time.h>             // clock_gettime()
+#include <net/if.h>           // if_nametoindex(), IFF_*
+#include <linux/if.h>         // IF_OPER_*
+#include <arpa/inet.h>        // inet_ntop()
+#include <fcntl.h>            // open()
+#include <sys/socket.h>       // socket(), bind(), send(), recv()
+#include <linux/netlink.h>    // NETLINK_ROUTE, struct nlmsghdr, NLMSG_*
+#include <linux/rtnetlink.h>  // RTM_*, RTMGRP_*, struct ifinfomsg, ifaddrmsg
+#include <linux/genetlink.h>  // NETLINK_GENERIC, struct genlmsghdr, CTRL_*
+#include <linux/nl80211.h>    // NL80211_*
 
 #define CANDIES_API static
 #include "candies.h"
@@ -11,7 +23,7 @@
 #define PROGRAM_URL  "https://github.com/domsson/candies/net-sysclass"
 
 #define PROGRAM_VER_MAJOR 0
-#define PROGRAM_VER_MINOR 2
+#define PROGRAM_VER_MINOR 5
 #define PROGRAM_VER_PATCH 0
 
 #define DEFAULT_INTERVAL     1
@@ -19,12 +31,22 @@
 #define DEFAULT_GRANULARITY "k"
 #define DEFAULT_NIC_MBPS     100 // max iface speed in Mbits (100 Mbit = 0.1 Gbit)
 #define DEFAULT_FORMAT      "%c" 
+#define DEFAULT_WINDOWS     { 60, 300, 900 } // seconds covered by peak, mean, p95
+#define MAX_WINDOWS          3
 
 #define STATS_FILE_FORMAT "/sys/class/net/%s/statistics/%s"
 #define STATS_FILE_RX     "rx_bytes"
 #define STATS_FILE_TX     "tx_bytes"
 #define STATS_FILE_BUFLEN  64
 
+#define NETLINK_GROUPS (RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR)
+#define NETLINK_BUFLEN 8192
+
+#define WIRELESS_DIR_FORMAT "/sys/class/net/%s/wireless"
+#define WIRELESS_PROCFILE   "/proc/net/wireless"
+#define WIRELESS_BUFLEN      4096
+#define WIRELESS_QUAL_MAX    70.0 // max link quality reported by cfg80211
+
 #define OUTPUT_SIZE 128
 #define RESULT_SIZE 16
 
@@ -34,6 +56,23 @@
 typedef unsigned long ulong;
 typedef unsigned char byte;
 
+// Statistics over all samples within one window
+struct stats
+{
+	ulong rx_max_abs;  // peak received
+	ulong tx_max_abs;  // peak transferred
+	ulong cx_max_abs;  // peak combined
+	ulong cx_mean_abs; // mean combined
+	ulong cx_p95_abs;  // 95th percentile combined
+	double rx_max_rel;
+	double tx_max_rel;
+	double cx_max_rel;
+	double cx_mean_rel;
+	double cx_p95_rel;
+};
+
+typedef struct stats stats_s;
+
 struct info
 {
 	ulong rx_abs; // received (down)
@@ -42,14 +81,78 @@ struct info
 	double rx_rel;
 	double tx_rel;
 	double cx_rel;
+
+	stats_s stats[MAX_WINDOWS]; // one per window, see `-w`
 };
 
 typedef struct info info_s;
 
+// Ring buffers holding the most recent samples, enough to cover the largest 
+// window; these are allocated once at startup, so there are no allocations 
+// in the main loop. A sample is only added once at least one interval has 
+// passed since the previous one, so readings taken early (in event mode) 
+// are merged into the next sample instead of taking up space of their own.
+struct window
+{
+	size_t size;         // capacity, in number of samples
+	size_t num;          // number of samples currently held
+	size_t head;         // index the next sample will be written to
+	ulong *rx;           // received bytes
+	ulong *tx;           // transmitted bytes
+	double *dt;          // seconds covered by the sample
+	double *t;           // time at the end of the sample
+	ulong *cx;           // scratch space for the percentile calculation
+	ulong rx_last;       // counters at the end of the last sample
+	ulong tx_last;
+	double t_last;
+};
+
+typedef struct window window_s;
+
+// Wireless link information, either from nl80211 or /proc/net/wireless
+struct wifi
+{
+	int nl_fd;           // generic netlink socket, -1 if not in use
+	int proc_fd;         // held-open /proc/net/wireless, -1 if not in use
+	int family;          // nl80211 generic netlink family id
+	int index;           // interface index of `iface`
+	unsigned seq;        // sequence number of the last request
+	double quality;      // link quality, in percent
+	double signal;       // signal level, in dBm
+	double noise;        // noise level, in dBm
+	double bitrate;      // tx bitrate, in Mbit/s
+};
+
+typedef struct wifi wifi_s;
+
+// Link state as reported by rtnetlink; unlike `info`, this is kept between
+// iterations and only updated when the kernel notifies us about a change
+struct link
+{
+	int fd;                             // rtnetlink socket, -1 if not in use
+	int index;                          // interface index of `iface`
+	char name[IF_NAMESIZE];             // `iface`, to find it again by name
+	unsigned flags;                     // IFF_* flags of the interface
+	byte operstate;                     // IF_OPER_* state (RFC 2863)
+	byte resync : 1;                    // address list needs to be dumped again
+	char addr4[INET_ADDRSTRLEN];        // primary IPv4 address, if any
+	char addr6[INET6_ADDRSTRLEN];       // first global IPv6 address, if any
+};
+
+typedef struct link link_s;
+
+// Names of the IF_OPER_* states, as used in /sys/class/net/<iface>/operstate
+static char *operstates[] = {
+	"unknown", "notpresent", "down", "lowerlayerdown", "testing", "dormant", "up"
+};
+
+#define OPERSTATES_NUM (sizeof(operstates) / sizeof(operstates[0]))
+
 struct options
 {
 	byte monitor : 1;    // keep running and printing
-	byte continuous : 1; // keep printing even if output hasn't changed 
+	byte continuous : 1; // keep printing even if output hasn't changed
+	byte event : 1;      // wake up on link/address events (netlink)
 	byte unit : 1;	     // also print the % unit
 	byte space : 1;      // space between val and unit
 	byte help : 1;       // show help and exit
@@ -57,6 +160,8 @@ struct options
 	int interval;        // print every `interval` seconds
 	int precision;       // decimal places in output
 	int nic_mbps;        // network interface card max speed in Mbps
+	int windows[MAX_WINDOWS]; // seconds covered by peak, mean and p95 values
+	size_t num_windows;  // number of elements in `windows`
 	char granularity;    // unit granularity (m = mega, g = giga, etc)
 	char *iface;         // network interface to query
 	char *format;        // format string
@@ -75,6 +180,9 @@ struct context
 {
 	info_s *info;
 	opts_s *opts;
+	link_s *link;
+	wifi_s *wifi;
+	stats_s *stats;      // stats of the window selected via `%1` .. `%3`
 	char buffer[RESULT_SIZE];
 	char output_prev[OUTPUT_SIZE];
 	char output_curr[OUTPUT_SIZE];
@@ -87,10 +195,13 @@ fetch_opts(opts_s *opts, int argc, char **argv)
 {
 	opterr = 0;
 	int o;
-	while ((o = getopt(argc, argv, "f:g:hi:I:kmp:r:suV")) != -1)
+	while ((o = getopt(argc, argv, "ef:g:hi:I:kmp:r:suVw:")) != -1)
 	{
 		switch (o)
 		{
+			case 'e':
+				opts->event = 1;
+				break;
 			case 'f':
 				opts->format = optarg;
 				break;
@@ -127,6 +238,12 @@ fetch_opts(opts_s *opts, int argc, char **argv)
 			case 'V':
 				opts->version = 1;
 				break;
+			case 'w':
+				if (opts->num_windows < MAX_WINDOWS)
+				{
+					opts->windows[opts->num_windows++] = atoi(optarg);
+				}
+				break;
 		}
 	}
 }
@@ -141,6 +258,7 @@ help(char *invocation, FILE* stream)
      	fprintf(stream, "\t%s [OPTIONS...]\n", invocation);
 	fprintf(stream, "\n");
 	fprintf(stream, "Options:\n");
+	fprintf(stream, "\t-e Print immediately on link state or address changes (implies -m)\n");
 	fprintf(stream, "\t-f Output format string\n");
 	fprintf(stream, "\t-h Print this help text and exit\n");
 	fprintf(stream, "\t-i Seconds between checking for a change in value; default is 1\n");
@@ -153,6 +271,22 @@ help(char *invocation, FILE* stream)
 	fprintf(stream, "\t-t Required change in value in order to print again; default is 1\n");
 	fprintf(stream, "\t-u Print the appropriate unit after the value\n");
 	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\t-w Seconds covered by peak, mean and p95 values, up to 3 times; default is 60, 300, 900\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "Format specifiers:\n");
+	fprintf(stream, "\t%%r, %%t, %%c: Received, transmitted, combined (percent)\n");
+	fprintf(stream, "\t%%R, %%T, %%C: Received, transmitted, combined (absolute)\n");
+	fprintf(stream, "\t%%d, %%u, %%x: Peak received, transmitted, combined (percent)\n");
+	fprintf(stream, "\t%%D, %%U, %%X: Peak received, transmitted, combined (absolute)\n");
+	fprintf(stream, "\t%%m, %%M: Mean combined (percent and absolute)\n");
+	fprintf(stream, "\t%%p, %%P: 95th percentile combined (percent and absolute)\n");
+	fprintf(stream, "\t%%1, %%2, %%3: Use 1st, 2nd, 3rd window for the above from here on\n");
+	fprintf(stream, "\t%%q: Wireless link quality (percent)\n");
+	fprintf(stream, "\t%%s, %%n: Wireless signal and noise level (dBm)\n");
+	fprintf(stream, "\t%%b: Wireless bitrate (Mbit/s)\n");
+	fprintf(stream, "\t%%l: Link state (up, down)\n");
+	fprintf(stream, "\t%%o: Operational state (up, down, dormant, ...)\n");
+	fprintf(stream, "\t%%a: Primary address (IPv4 if available, otherwise IPv6)\n");
 }
 
 /*
@@ -188,17 +322,850 @@ read_file_to_var(const char *file, ulong *value)
 	return 0;
 }
 
+/*
+ * Returns the current time of the monotonic clock, in seconds.
+ */
+static double
+get_time()
+{
+	struct timespec ts = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/*
+ * Checks whether the format string makes use of any of the given specifiers.
+ */
+static int
+uses_specifier(const char *format, const char *specifiers)
+{
+	for (; *format; ++format)
+	{
+		if (*format == '%' && format[1])
+		{
+			if (strchr(specifiers, *++format))
+			{
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Opens a netlink socket that subscribes to link and address notifications.
+ * Returns 0 on success, -1 if the interface doesn't exist or the socket could
+ * not be created.
+ */
+static int
+link_open(link_s* link, const char *iface)
+{
+	link->index = if_nametoindex(iface);
+	if (link->index == 0)
+	{
+		return -1;
+	}
+	snprintf(link->name, IF_NAMESIZE, "%s", iface);
+
+	link->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (link->fd == -1)
+	{
+		return -1;
+	}
+
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK, .nl_groups = NETLINK_GROUPS };
+	if (bind(link->fd, (struct sockaddr*) &sa, sizeof(sa)) == -1)
+	{
+		close(link->fd);
+		link->fd = -1;
+		return -1;
+	}
+
+	// don't ever block forever on a reply that might have been dropped
+	struct timeval tv = { .tv_sec = 1 };
+	setsockopt(link->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	return 0;
+}
+
+/*
+ * Checks whether the given RTM_NEWLINK message is about an interface with 
+ * the given name. Returns 1 if so, otherwise 0.
+ */
+static int
+link_has_name(struct nlmsghdr *nh, const char *name)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(nh);
+	int len = IFLA_PAYLOAD(nh);
+	struct rtattr *rta = IFLA_RTA(ifi);
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+	{
+		if (rta->rta_type == IFLA_IFNAME)
+		{
+			return strncmp(RTA_DATA(rta), name, RTA_PAYLOAD(rta)) == 0;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Processes a RTM_NEWLINK or RTM_DELLINK message.
+ * Returns 1 if the message concerned our interface, otherwise 0.
+ */
+static int
+link_parse_link(link_s* link, struct nlmsghdr *nh)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(nh);
+	if (ifi->ifi_index != link->index)
+	{
+		// once removed, the interface might come back (USB tethering, VPN 
+		// restart, driver reload, ...), but with a new index
+		if (nh->nlmsg_type != RTM_NEWLINK || 
+				link->operstate != IF_OPER_NOTPRESENT ||
+				!link_has_name(nh, link->name))
+		{
+			return 0;
+		}
+		link->index = ifi->ifi_index;
+		link->resync = 1;
+	}
+
+	if (nh->nlmsg_type == RTM_DELLINK)
+	{
+		link->flags = 0;
+		link->operstate = IF_OPER_NOTPRESENT;
+		link->addr4[0] = '\0';
+		link->addr6[0] = '\0';
+		return 1;
+	}
+
+	link->flags = ifi->ifi_flags;
+
+	int len = IFLA_PAYLOAD(nh);
+	struct rtattr *rta = IFLA_RTA(ifi);
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+	{
+		if (rta->rta_type == IFLA_OPERSTATE)
+		{
+			link->operstate = *(byte*) RTA_DATA(rta);
+		}
+	}
+	return 1;
+}
+
+/*
+ * Processes a RTM_NEWADDR or RTM_DELADDR message. We only keep track of the 
+ * primary IPv4 address and the first global IPv6 address of the interface.
+ * Returns 1 if the message concerned our interface, otherwise 0.
+ */
+static int
+link_parse_addr(link_s* link, struct nlmsghdr *nh)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+	if ((int) ifa->ifa_index != link->index)
+	{
+		return 0;
+	}
+
+	char *dest = NULL;
+	size_t size = 0;
+
+	switch (ifa->ifa_family)
+	{
+		case AF_INET:
+			dest = link->addr4;
+			size = sizeof(link->addr4);
+			break;
+		case AF_INET6:
+			dest = link->addr6;
+			size = sizeof(link->addr6);
+			break;
+		default:
+			return 0;
+	}
+
+	// skip secondary IPv4 addresses as well as link-local IPv6 addresses
+	if (ifa->ifa_flags & IFA_F_SECONDARY || 
+			(ifa->ifa_family == AF_INET6 && ifa->ifa_scope != RT_SCOPE_UNIVERSE))
+	{
+		return 0;
+	}
+
+	// IFA_LOCAL is only different from IFA_ADDRESS on point-to-point links,
+	// where it is the local address (and IFA_ADDRESS the remote one)
+	void *data = NULL;
+	int len = IFA_PAYLOAD(nh);
+	struct rtattr *rta = IFA_RTA(ifa);
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+	{
+		if (rta->rta_type == IFA_LOCAL || (rta->rta_type == IFA_ADDRESS && data == NULL))
+		{
+			data = RTA_DATA(rta);
+		}
+	}
+
+	char addr[INET6_ADDRSTRLEN] = { 0 };
+	if (data == NULL || inet_ntop(ifa->ifa_family, data, addr, size) == NULL)
+	{
+		return 0;
+	}
+
+	if (nh->nlmsg_type == RTM_NEWADDR && dest[0] == '\0')
+	{
+		strcpy(dest, addr);
+	}
+	else if (nh->nlmsg_type == RTM_DELADDR && strcmp(dest, addr) == 0)
+	{
+		// another address might take its place, we'll have to ask
+		dest[0] = '\0';
+		link->resync = 1;
+	}
+	return 1;
+}
+
+/*
+ * Reads one datagram worth of messages from the netlink socket and processes 
+ * them. If `done` is given and a message with sequence number `seq` finishes 
+ * the reply to one of our requests, `done` is set to 1. Returns the number of
+ * messages that concerned our interface or -1 if nothing could be read.
+ */
+static int
+link_recv(link_s* link, int flags, unsigned seq, int *done)
+{
+	char buf[NETLINK_BUFLEN] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+	int len = recv(link->fd, buf, sizeof(buf), flags);
+	if (len == -1 && errno == ENOBUFS)
+	{
+		// we've missed notifications, so we need to ask for everything
+		link->resync = 1;
+		return 1;
+	}
+	if (len <= 0)
+	{
+		return -1;
+	}
+
+	int num = 0;
+	struct nlmsghdr *nh = (struct nlmsghdr*) buf;
+	for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+	{
+		if (done && seq && nh->nlmsg_seq == seq && 
+				(nh->nlmsg_type == NLMSG_DONE ||
+				 nh->nlmsg_type == NLMSG_ERROR ||
+				 (nh->nlmsg_flags & NLM_F_MULTI) == 0))
+		{
+			*done = 1;
+		}
+
+		switch (nh->nlmsg_type)
+		{
+			case RTM_NEWLINK:
+			case RTM_DELLINK:
+				num += link_parse_link(link, nh);
+				break;
+			case RTM_NEWADDR:
+			case RTM_DELADDR:
+				num += link_parse_addr(link, nh);
+				break;
+		}
+	}
+	return num;
+}
+
+/*
+ * Sends a RTM_GETLINK (for our interface only) or RTM_GETADDR (dump) request
+ * and processes all messages until the reply has been received completely.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+link_request(link_s* link, unsigned short type, unsigned seq)
+{
+	struct
+	{
+		struct nlmsghdr nh;
+		union
+		{
+			struct ifinfomsg ifi;
+			struct ifaddrmsg ifa;
+		};
+	}
+	req = { 0 };
+
+	req.nh.nlmsg_type = type;
+	req.nh.nlmsg_seq  = seq;
+
+	if (type == RTM_GETLINK)
+	{
+		req.nh.nlmsg_len   = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+		req.nh.nlmsg_flags = NLM_F_REQUEST;
+		req.ifi.ifi_family = AF_UNSPEC;
+		req.ifi.ifi_index  = link->index;
+	}
+	else
+	{
+		req.nh.nlmsg_len   = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+		req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+		req.ifa.ifa_family = AF_UNSPEC;
+	}
+
+	if (send(link->fd, &req, req.nh.nlmsg_len, 0) == -1)
+	{
+		return -1;
+	}
+
+	int done = 0;
+	while (done == 0)
+	{
+		if (link_recv(link, 0, seq, &done) == -1)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Queries the current link state and addresses of our interface.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+link_sync(link_s* link)
+{
+	link->resync = 0;
+	link->addr4[0] = '\0';
+	link->addr6[0] = '\0';
+
+	if (link_request(link, RTM_GETLINK, 1) == -1)
+	{
+		return -1;
+	}
+	if (link_request(link, RTM_GETADDR, 2) == -1)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Processes all pending notifications without blocking. 
+ * Returns the number of notifications that concerned our interface.
+ */
+static int
+link_update(link_s* link)
+{
+	int num = 0;
+	int ret = 0;
+	while ((ret = link_recv(link, MSG_DONTWAIT, 0, NULL)) != -1)
+	{
+		num += ret;
+	}
+
+	if (link->resync && link_sync(link) == -1)
+	{
+		// try again next time
+		link->resync = 1;
+	}
+	return num;
+}
+
+/*
+ * Waits for `interval` seconds. In event mode, returns early as soon as there
+ * was a change in link state or addresses of the interface.
+ */
+static void
+wait_interval(opts_s* opts, link_s* link)
+{
+	if (opts->event == 0)
+	{
+		sleep(opts->interval);
+		return;
+	}
+
+	double until = get_time() + opts->interval;
+	double left  = opts->interval;
+	struct pollfd pfd = { .fd = link->fd, .events = POLLIN };
+
+	while (left > 0)
+	{
+		int ret = poll(&pfd, 1, (int) (left * 1000));
+		if (ret == -1 && errno != EINTR)
+		{
+			sleep(opts->interval);
+			return;
+		}
+		if (ret > 0 && link_update(link) > 0)
+		{
+			return;
+		}
+		left = until - get_time();
+	}
+}
+
+/*
+ * Allocates the ring buffers for `size` samples. Returns 0 on success, -1 on
+ * error. This is the only place where memory for the window gets allocated.
+ */
+static int
+window_init(window_s* win, size_t size)
+{
+	win->size = size;
+	win->rx = calloc(size, sizeof(ulong));
+	win->tx = calloc(size, sizeof(ulong));
+	win->dt = calloc(size, sizeof(double));
+	win->t  = calloc(size, sizeof(double));
+	win->cx = calloc(size, sizeof(ulong));
+	return win->rx && win->tx && win->dt && win->t && win->cx ? 0 : -1;
+}
+
+static void
+window_free(window_s* win)
+{
+	free(win->rx);
+	free(win->tx);
+	free(win->dt);
+	free(win->t);
+	free(win->cx);
+}
+
+/*
+ * Adds a sample covering everything since the last one to the window, 
+ * overwriting the oldest one if the window is full, unless less than 
+ * `interval` seconds have passed since then. Returns 1 if a sample was 
+ * added, 0 otherwise.
+ */
+static int
+window_add(window_s* win, ulong rx, ulong tx, double t, int interval)
+{
+	if (t - win->t_last < interval)
+	{
+		return 0;
+	}
+
+	win->rx[win->head] = rx - win->rx_last;
+	win->tx[win->head] = tx - win->tx_last;
+	win->dt[win->head] = t - win->t_last;
+	win->t[win->head]  = t;
+	win->head = (win->head + 1) % win->size;
+	if (win->num < win->size)
+	{
+		++win->num;
+	}
+
+	win->rx_last = rx;
+	win->tx_last = tx;
+	win->t_last  = t;
+	return 1;
+}
+
+static int
+compare_ulong(const void* a, const void* b)
+{
+	ulong ua = *(const ulong*) a;
+	ulong ub = *(const ulong*) b;
+	return (ua > ub) - (ua < ub);
+}
+
+/*
+ * Calculates peak, mean and 95th percentile over all samples that ended 
+ * within the last `seconds` seconds. The mean is weighted by time, that is, 
+ * all bytes within the window divided by the time covered by its samples.
+ */
+static void
+window_stats(window_s* win, int seconds, stats_s* stats)
+{
+	double bytes = 0.0;
+	double time  = 0.0;
+	size_t num   = 0;
+
+	// walk backwards from the newest sample until we leave the window
+	for (; num < win->num; ++num)
+	{
+		size_t i = (win->head + win->size - 1 - num) % win->size;
+		if (win->t[i] <= win->t_last - seconds)
+		{
+			break;
+		}
+
+		ulong rx = (ulong) (win->rx[i] / win->dt[i]);
+		ulong tx = (ulong) (win->tx[i] / win->dt[i]);
+		win->cx[num] = rx + tx;
+		bytes += win->rx[i] + win->tx[i];
+		time  += win->dt[i];
+
+		if (rx > stats->rx_max_abs) stats->rx_max_abs = rx;
+		if (tx > stats->tx_max_abs) stats->tx_max_abs = tx;
+		if (win->cx[num] > stats->cx_max_abs) stats->cx_max_abs = win->cx[num];
+	}
+
+	if (num == 0)
+	{
+		return;
+	}
+
+	stats->cx_mean_abs = (ulong) (bytes / time);
+
+	// nearest-rank method: the smallest sample that is greater than or 
+	// equal to 95 percent of all samples
+	qsort(win->cx, num, sizeof(ulong), compare_ulong);
+	stats->cx_p95_abs = win->cx[((num * 95) + 99) / 100 - 1];
+}
+
+/*
+ * Turns the given throughput, in bytes per second, into percent of the given
+ * throughput in Mbit per second.
+ */
+static double
+calc_rel(ulong bytes, double mbps)
+{
+	return (((bytes * 8.0) / 1000000.0) / mbps) * 100.0;
+}
+
+/*
+ * Sends a generic netlink request with a single attribute.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+wifi_request(wifi_s* wifi, int family, byte cmd, unsigned short flags,
+		unsigned short type, const void* data, size_t len)
+{
+	struct
+	{
+		struct nlmsghdr nh;
+		struct genlmsghdr gh;
+		char attrs[NLA_HDRLEN + 64];
+	}
+	req = { 0 };
+
+	if (NLA_ALIGN(len) > sizeof(req.attrs) - NLA_HDRLEN)
+	{
+		return -1;
+	}
+
+	struct nlattr *nla = (struct nlattr*) req.attrs;
+	nla->nla_type = type;
+	nla->nla_len  = NLA_HDRLEN + len;
+	memcpy(req.attrs + NLA_HDRLEN, data, len);
+
+	req.nh.nlmsg_len   = NLMSG_LENGTH(GENL_HDRLEN + NLA_HDRLEN + NLA_ALIGN(len));
+	req.nh.nlmsg_type  = family;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | flags;
+	req.nh.nlmsg_seq   = ++wifi->seq;
+	req.gh.cmd         = cmd;
+	req.gh.version     = 1;
+
+	return send(wifi->nl_fd, &req, req.nh.nlmsg_len, 0) == -1 ? -1 : 0;
+}
+
+/*
+ * Looks for the attribute of the given type in a stream of attributes.
+ * Returns a pointer to the attribute if found, otherwise NULL.
+ */
+static struct nlattr*
+wifi_attr(void* data, int len, unsigned short type)
+{
+	struct nlattr *nla = data;
+	while (len >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN && nla->nla_len <= len)
+	{
+		if ((nla->nla_type & NLA_TYPE_MASK) == type)
+		{
+			return nla;
+		}
+		len -= NLA_ALIGN(nla->nla_len);
+		nla = (struct nlattr*) ((char*) nla + NLA_ALIGN(nla->nla_len));
+	}
+	return NULL;
+}
+
+#define NLA_DATA(nla) ((void*) ((char*) (nla) + NLA_HDRLEN))
+#define NLA_LEN(nla)  ((int) (nla)->nla_len - NLA_HDRLEN)
+
+/*
+ * Processes one reply message to one of our nl80211 (or nlctrl) requests.
+ */
+static void
+wifi_parse(wifi_s* wifi, struct genlmsghdr *gh, int len)
+{
+	void *attrs = (char*) gh + GENL_HDRLEN;
+	len -= GENL_HDRLEN;
+
+	struct nlattr *nla = NULL;
+	struct nlattr *sub = NULL;
+
+	switch (gh->cmd)
+	{
+		case CTRL_CMD_NEWFAMILY:
+			if ((nla = wifi_attr(attrs, len, CTRL_ATTR_FAMILY_ID)))
+			{
+				wifi->family = *(unsigned short*) NLA_DATA(nla);
+			}
+			break;
+		case NL80211_CMD_NEW_STATION:
+			if ((nla = wifi_attr(attrs, len, NL80211_ATTR_STA_INFO)) == NULL)
+			{
+				break;
+			}
+			if ((sub = wifi_attr(NLA_DATA(nla), NLA_LEN(nla), NL80211_STA_INFO_SIGNAL)))
+			{
+				wifi->signal = *(signed char*) NLA_DATA(sub);
+			}
+			if ((sub = wifi_attr(NLA_DATA(nla), NLA_LEN(nla), NL80211_STA_INFO_TX_BITRATE)))
+			{
+				struct nlattr *rate = NULL;
+				if ((rate = wifi_attr(NLA_DATA(sub), NLA_LEN(sub), NL80211_RATE_INFO_BITRATE32)))
+				{
+					wifi->bitrate = *(unsigned*) NLA_DATA(rate) / 10.0;
+				}
+				else if ((rate = wifi_attr(NLA_DATA(sub), NLA_LEN(sub), NL80211_RATE_INFO_BITRATE)))
+				{
+					wifi->bitrate = *(unsigned short*) NLA_DATA(rate) / 10.0;
+				}
+			}
+			break;
+		case NL80211_CMD_NEW_SURVEY_RESULTS:
+			if ((nla = wifi_attr(attrs, len, NL80211_ATTR_SURVEY_INFO)) == NULL)
+			{
+				break;
+			}
+			// we're only interested in the channel currently in use
+			if (wifi_attr(NLA_DATA(nla), NLA_LEN(nla), NL80211_SURVEY_INFO_IN_USE) == NULL)
+			{
+				break;
+			}
+			if ((sub = wifi_attr(NLA_DATA(nla), NLA_LEN(nla), NL80211_SURVEY_INFO_NOISE)))
+			{
+				wifi->noise = *(signed char*) NLA_DATA(sub);
+			}
+			break;
+	}
+}
+
+/*
+ * Reads and processes all replies to the last request.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+wifi_recv(wifi_s* wifi)
+{
+	char buf[NETLINK_BUFLEN] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+	for (;;)
+	{
+		int len = recv(wifi->nl_fd, buf, sizeof(buf), 0);
+		if (len == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (len <= 0)
+		{
+			return -1;
+		}
+
+		struct nlmsghdr *nh = (struct nlmsghdr*) buf;
+		for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+		{
+			if (nh->nlmsg_seq != wifi->seq)
+			{
+				continue;
+			}
+			if (nh->nlmsg_type == NLMSG_DONE)
+			{
+				return 0;
+			}
+			if (nh->nlmsg_type == NLMSG_ERROR)
+			{
+				// the error field is 0 for acknowledgements
+				return ((struct nlmsgerr*) NLMSG_DATA(nh))->error ? -1 : 0;
+			}
+
+			wifi_parse(wifi, NLMSG_DATA(nh), nh->nlmsg_len - NLMSG_HDRLEN);
+
+			if ((nh->nlmsg_flags & NLM_F_MULTI) == 0)
+			{
+				return 0;
+			}
+		}
+	}
+}
+
+/*
+ * Prepares everything needed to read wireless link information for the given
+ * interface. We prefer nl80211 and fall back to /proc/net/wireless if that is
+ * not available. Returns 0 on success, -1 if neither could be used.
+ */
+static int
+wifi_open(wifi_s* wifi, const char *iface)
+{
+	wifi->index = if_nametoindex(iface);
+	if (wifi->index == 0)
+	{
+		return -1;
+	}
+
+	wifi->nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+	if (wifi->nl_fd != -1)
+	{
+		struct timeval tv = { .tv_sec = 1 };
+		setsockopt(wifi->nl_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+		// ask the generic netlink controller for the nl80211 family id
+		if (wifi_request(wifi, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 0,
+				CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME,
+				sizeof(NL80211_GENL_NAME)) == 0 &&
+			wifi_recv(wifi) == 0 && wifi->family != 0)
+		{
+			return 0;
+		}
+
+		close(wifi->nl_fd);
+		wifi->nl_fd = -1;
+	}
+
+	wifi->proc_fd = open(WIRELESS_PROCFILE, O_RDONLY | O_CLOEXEC);
+	return wifi->proc_fd == -1 ? -1 : 0;
+}
+
+static void
+wifi_close(wifi_s* wifi)
+{
+	if (wifi->nl_fd != -1)
+	{
+		close(wifi->nl_fd);
+	}
+	if (wifi->proc_fd != -1)
+	{
+		close(wifi->proc_fd);
+	}
+}
+
+/*
+ * Parses the line of our interface from /proc/net/wireless, which looks like:
+ * "wlan0: 0000   54.  -56.  -256        0      0      0      0      0        0"
+ * Returns 0 on success, -1 on error.
+ */
+static int
+wifi_parse_proc(wifi_s* wifi, const char *iface)
+{
+	char buf[WIRELESS_BUFLEN];
+	ssize_t len = pread(wifi->proc_fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+	{
+		return -1;
+	}
+	buf[len] = '\0';
+
+	size_t iface_len = strlen(iface);
+	char *line = buf;
+	for (; line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL)
+	{
+		line += strspn(line, " ");
+		if (strncmp(line, iface, iface_len) != 0 || line[iface_len] != ':')
+		{
+			continue;
+		}
+
+		double link = 0.0;
+		if (sscanf(line + iface_len + 1, "%*x %lf%*[. ] %lf%*[. ] %lf",
+				&link, &wifi->signal, &wifi->noise) != 3)
+		{
+			return -1;
+		}
+
+		wifi->quality = (link / WIRELESS_QUAL_MAX) * 100.0;
+		if (wifi->noise <= -256.0)
+		{
+			// -256 means "unknown", as in not reported by the driver
+			wifi->noise = 0.0;
+		}
+		return 0;
+	}
+
+	// interface not listed, which means it isn't associated (or not wireless)
+	return 0;
+}
+
+static void
+wifi_reset(wifi_s* wifi)
+{
+	wifi->quality = 0.0;
+	wifi->signal  = 0.0;
+	wifi->noise   = 0.0;
+	wifi->bitrate = 0.0;
+}
+
+/*
+ * Fetches the current wireless link information. If the interface isn't
+ * associated, all values will be 0. Returns 0 on success, -1 on error, in 
+ * which case all values will be 0 as well.
+ */
+static int
+wifi_update(wifi_s* wifi, const char *iface)
+{
+	wifi_reset(wifi);
+
+	if (wifi->proc_fd != -1)
+	{
+		if (wifi_parse_proc(wifi, iface) == -1)
+		{
+			wifi_reset(wifi);
+			return -1;
+		}
+		return 0;
+	}
+
+	unsigned index = wifi->index;
+	if (wifi_request(wifi, wifi->family, NL80211_CMD_GET_STATION, NLM_F_DUMP,
+			NL80211_ATTR_IFINDEX, &index, sizeof(index)) == -1 ||
+			wifi_recv(wifi) == -1)
+	{
+		// the device might have been removed and added again, in which 
+		// case it has a new index; look it up again for the next try
+		wifi->index = if_nametoindex(iface);
+		wifi_reset(wifi);
+		return -1;
+	}
+
+	// nl80211 has no notion of link quality, so we derive it from the 
+	// signal level, mapping -100 dBm to 0 % and -50 dBm to 100 %
+	if (wifi->signal < 0.0)
+	{
+		wifi->quality = 2.0 * (wifi->signal + 100.0);
+		wifi->quality = wifi->quality < 0.0 ? 0.0 : (wifi->quality > 100.0 ? 100.0 : wifi->quality);
+	}
+
+	// the noise level is only reported in the channel survey, which not all
+	// drivers support; in that case, noise will simply remain at 0
+	if (wifi_request(wifi, wifi->family, NL80211_CMD_GET_SURVEY, NLM_F_DUMP,
+			NL80211_ATTR_IFINDEX, &index, sizeof(index)) == 0)
+	{
+		wifi_recv(wifi);
+	}
+
+	return 0;
+}
+
 static int 
-fetch_info(opts_s* opts, info_s* info, ulong* rx_prev, ulong* tx_prev)
+fetch_info(opts_s* opts, info_s* info, link_s* link, window_s* win, wifi_s* wifi, ulong* rx_prev, ulong* tx_prev, double* t_prev)
 {
-	if (*rx_prev == 0 && *tx_prev == 0)
+	if (*t_prev == 0.0)
 	{
 		// TODO: add error handling (this might return -1)
 		read_file_to_var(opts->rx_file, rx_prev);
 		read_file_to_var(opts->tx_file, tx_prev);
+		*t_prev = get_time();
+
+		// the first sample of the window starts here as well
+		win->rx_last = *rx_prev;
+		win->tx_last = *tx_prev;
+		win->t_last  = *t_prev;
 	}
 
-	sleep(opts->interval);
+	wait_interval(opts, link);
+
+	if (link->fd != -1)
+	{
+		link_update(link);
+	}
 	
 	ulong rx_curr = 0;
 	ulong tx_curr = 0;
@@ -206,27 +1173,59 @@ fetch_info(opts_s* opts, info_s* info, ulong* rx_prev, ulong* tx_prev)
 	// TODO: add error handling (this might return -1)
 	read_file_to_var(opts->rx_file, &rx_curr);
 	read_file_to_var(opts->tx_file, &tx_curr);
+	double t_curr = get_time();
+
+	// wireless information is sampled along with the byte counters; errors 
+	// (like the device going away for a moment) leave the values at 0, but 
+	// are no reason to give up on the byte counters
+	if (wifi->nl_fd != -1 || wifi->proc_fd != -1)
+	{
+		wifi_update(wifi, opts->iface);
+	}
 	
 	ulong delta_rx = rx_curr - *rx_prev;
 	ulong delta_tx = tx_curr - *tx_prev;
+	double delta_t = t_curr - *t_prev;
 
 	*rx_prev = rx_curr;
 	*tx_prev = tx_curr;
+	*t_prev  = t_curr;
+
+	// in event mode, we might have been woken up early
+	if (delta_t <= 0.0)
+	{
+		delta_t = opts->interval;
+	}
 
 	// absolute values in bytes
-	info->rx_abs = (ulong) (delta_rx / (float) opts->interval);
-	info->tx_abs = (ulong) (delta_tx / (float) opts->interval);
+	info->rx_abs = (ulong) (delta_rx / delta_t);
+	info->tx_abs = (ulong) (delta_tx / delta_t);
 	info->cx_abs = info->rx_abs + info->tx_abs;
 
-	// bytes to Mbits
-	double rx_abs_mbit = (info->rx_abs * 8.0) / 1000000.0;
-	double tx_abs_mbit = (info->tx_abs * 8.0) / 1000000.0;
-	double cx_abs_mbit = (info->cx_abs * 8.0) / 1000000.0;
-
 	// relative values in percent of NIC max throughput
-	info->rx_rel = (rx_abs_mbit / (double) opts->nic_mbps) * 100.0;
-	info->tx_rel = (tx_abs_mbit / (double) opts->nic_mbps) * 100.0;
-	info->cx_rel = (cx_abs_mbit / ((double) opts->nic_mbps * 2)) * 100.0; 
+	info->rx_rel = calc_rel(info->rx_abs, opts->nic_mbps);
+	info->tx_rel = calc_rel(info->tx_abs, opts->nic_mbps);
+	info->cx_rel = calc_rel(info->cx_abs, opts->nic_mbps * 2.0);
+
+	if (win->size == 0)
+	{
+		return 0;
+	}
+
+	// statistics over the windows, including the current sample; in event 
+	// mode, the current sample might be merged into the next one instead
+	window_add(win, rx_curr, tx_curr, t_curr, opts->interval);
+	for (size_t w = 0; w < opts->num_windows; ++w)
+	{
+		stats_s *stats = &info->stats[w];
+		window_stats(win, opts->windows[w], stats);
+
+		stats->rx_max_rel  = calc_rel(stats->rx_max_abs,  opts->nic_mbps);
+		stats->tx_max_rel  = calc_rel(stats->tx_max_abs,  opts->nic_mbps);
+		stats->cx_max_rel  = calc_rel(stats->cx_max_abs,  opts->nic_mbps * 2.0);
+		stats->cx_mean_rel = calc_rel(stats->cx_mean_abs, opts->nic_mbps * 2.0);
+		stats->cx_p95_rel  = calc_rel(stats->cx_p95_abs,  opts->nic_mbps * 2.0);
+	}
 	
 	return 0;
 }
@@ -253,6 +1252,27 @@ format_abs_value(char *buf, size_t len, double val, opts_s* opts)
 	);
 }
 
+static void
+format_dbm_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.0lf%s%s",
+		val,
+		opts->space && opts->unit ? " " : "",
+	       	opts->unit ? "dBm" : ""
+	);
+}
+
+static void
+format_rate_value(char *buf, size_t len, double val, opts_s* opts)
+{
+	snprintf(buf, len, "%.*lf%s%s",
+		opts->precision,
+		val,
+		opts->space && opts->unit ? " " : "",
+	       	opts->unit ? MEGABIT_ABBR "/s" : ""
+	);
+}
+
 static char*
 candy_format_cb(char c, void* context)
 {
@@ -284,6 +1304,77 @@ candy_format_cb(char c, void* context)
 			format_abs_value(ctx->buffer, RESULT_SIZE,
 					ctx->info->cx_abs, ctx->opts);
 			return ctx->buffer;
+		case 'd': // rx (down), peak, relative
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->rx_max_rel, ctx->opts);
+			return ctx->buffer;
+		case 'u': // tx (up), peak, relative
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->tx_max_rel, ctx->opts);
+			return ctx->buffer;
+		case 'x': // combined, peak, relative
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->cx_max_rel, ctx->opts);
+			return ctx->buffer;
+		case 'm': // combined, mean, relative
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->cx_mean_rel, ctx->opts);
+			return ctx->buffer;
+		case 'p': // combined, 95th percentile, relative
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->cx_p95_rel, ctx->opts);
+			return ctx->buffer;
+		case 'D': // rx (down), peak, absolute
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->rx_max_abs, ctx->opts);
+			return ctx->buffer;
+		case 'U': // tx (up), peak, absolute
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->tx_max_abs, ctx->opts);
+			return ctx->buffer;
+		case 'X': // combined, peak, absolute
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->cx_max_abs, ctx->opts);
+			return ctx->buffer;
+		case 'M': // combined, mean, absolute
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->cx_mean_abs, ctx->opts);
+			return ctx->buffer;
+		case 'P': // combined, 95th percentile, absolute
+			format_abs_value(ctx->buffer, RESULT_SIZE,
+					ctx->stats->cx_p95_abs, ctx->opts);
+			return ctx->buffer;
+		case '1': // select window for the above
+		case '2':
+		case '3':
+			if ((size_t) (c - '1') < ctx->opts->num_windows)
+			{
+				ctx->stats = &ctx->info->stats[c - '1'];
+			}
+			return "";
+		case 'q': // wireless link quality
+			format_rel_value(ctx->buffer, RESULT_SIZE,
+					ctx->wifi->quality, ctx->opts);
+			return ctx->buffer;
+		case 's': // wireless signal level
+			format_dbm_value(ctx->buffer, RESULT_SIZE,
+					ctx->wifi->signal, ctx->opts);
+			return ctx->buffer;
+		case 'n': // wireless noise level
+			format_dbm_value(ctx->buffer, RESULT_SIZE,
+					ctx->wifi->noise, ctx->opts);
+			return ctx->buffer;
+		case 'b': // wireless bitrate
+			format_rate_value(ctx->buffer, RESULT_SIZE,
+					ctx->wifi->bitrate, ctx->opts);
+			return ctx->buffer;
+		case 'l': // link state (administrative)
+			return ctx->link->flags & IFF_UP ? "up" : "down";
+		case 'o': // operational state
+			return ctx->link->operstate < OPERSTATES_NUM ? 
+				operstates[ctx->link->operstate] : operstates[0];
+		case 'a': // primary address
+			return ctx->link->addr4[0] ? ctx->link->addr4 : ctx->link->addr6;
 		default:
 			return NULL;
 	}
@@ -292,6 +1383,7 @@ candy_format_cb(char c, void* context)
 static void
 format_info(ctx_s* ctx)
 {
+	ctx->stats = &ctx->info->stats[0];
 	candy_format(ctx->opts->format, ctx->output_curr, OUTPUT_SIZE, candy_format_cb, ctx);
 }
 
@@ -318,6 +1410,12 @@ main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	// event mode only makes sense if we keep running
+	if (opts.event)
+	{
+		opts.monitor = 1;
+	}
+
 	if (opts.interval == 0)
 	{
 		// We need some interval, as we need to take two measurements
@@ -341,6 +1439,28 @@ main(int argc, char **argv)
 		opts.format = DEFAULT_FORMAT;
 	}
 
+	// if no window sizes given, use the defaults (1, 5 and 15 minutes)
+	if (opts.num_windows == 0)
+	{
+		int windows[MAX_WINDOWS] = DEFAULT_WINDOWS;
+		memcpy(opts.windows, windows, sizeof(windows));
+		opts.num_windows = MAX_WINDOWS;
+	}
+
+	// the largest window determines the size of the ring buffer
+	int window_max = 0;
+	for (size_t w = 0; w < opts.num_windows; ++w)
+	{
+		if (opts.windows[w] <= 0)
+		{
+			opts.windows[w] = opts.interval;
+		}
+		if (opts.windows[w] > window_max)
+		{
+			window_max = opts.windows[w];
+		}
+	}
+
 	snprintf(opts.rx_file, STATS_FILE_BUFLEN, STATS_FILE_FORMAT, opts.iface, STATS_FILE_RX);
 	snprintf(opts.tx_file, STATS_FILE_BUFLEN, STATS_FILE_FORMAT, opts.iface, STATS_FILE_TX);
 
@@ -356,26 +1476,66 @@ main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	// subscribe to link and address changes, if we need them
+	link_s link = { .fd = -1 };
+	if (opts.event || uses_specifier(opts.format, "loa"))
+	{
+		if (link_open(&link, opts.iface) == -1 || link_sync(&link) == -1)
+		{
+			return EXIT_FAILURE;
+		}
+	}
+
+	// allocate the sample window once, if we need it
+	window_s win = { 0 };
+	if (uses_specifier(opts.format, "duxmpDUXMP"))
+	{
+		// samples are at least one interval apart, so this covers the window
+		size_t size = window_max / opts.interval + 1;
+		if (window_init(&win, size) == -1)
+		{
+			window_free(&win);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// prepare for reading wireless information, if we need it
+	wifi_s wifi = { .nl_fd = -1, .proc_fd = -1 };
+	if (uses_specifier(opts.format, "qsnb"))
+	{
+		char wireless_dir[STATS_FILE_BUFLEN];
+		snprintf(wireless_dir, STATS_FILE_BUFLEN, WIRELESS_DIR_FORMAT, opts.iface);
+
+		if (access(wireless_dir, F_OK) != 0 || wifi_open(&wifi, opts.iface) == -1)
+		{
+			window_free(&win);
+			return EXIT_FAILURE;
+		}
+	}
+
 	// make sure stdout is line buffered 
 	setlinebuf(stdout);
 
 	// data structures we'll need from here on out
 	info_s info = { 0 };
-	ctx_s ctx = { .info = &info, .opts = &opts };
+	ctx_s ctx = { .info = &info, .opts = &opts, .link = &link, .wifi = &wifi };
 
 	candy_unit_info(opts.granularity, 1, 0, &opts.unit_size, &opts.unit_abbr);
 
 	// soymeat
 	ulong rx = 0;
 	ulong tx = 0;
+	double t = 0.0;
 
 	do
 	{
 		// zero out the gathered info from last iteration, if any
 		info = (const info_s) { 0 };
 
-		if (fetch_info(&opts, &info, &rx, &tx) == -1)
+		if (fetch_info(&opts, &info, &link, &win, &wifi, &rx, &tx, &t) == -1)
 		{
+			wifi_close(&wifi);
+			window_free(&win);
 			return EXIT_FAILURE;
 		}
 
@@ -390,6 +1550,8 @@ main(int argc, char **argv)
 	}
 	while (opts.monitor);
 
+	wifi_close(&wifi);
+	window_free(&win);
 	return EXIT_SUCCESS;
 }
 
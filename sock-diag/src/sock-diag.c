@@ -0,0 +1,471 @@
+#include <stdio.h>            // fprintf()
+#include <stdlib.h>           // NULL, EXIT_*
+#include <unistd.h>           // getopt() et al., close()
+#include <string.h>           // strcmp(), strcpy(), strchr()
+#include <errno.h>            // errno
+#include <netinet/in.h>       // IPPROTO_*
+#include <sys/socket.h>       // socket(), send(), recv()
+#include <linux/netlink.h>    // NETLINK_SOCK_DIAG, struct nlmsghdr, NLMSG_*
+#include <linux/sock_diag.h>  // SOCK_DIAG_BY_FAMILY
+#include <linux/inet_diag.h>  // struct inet_diag_req_v2, inet_diag_msg
+
+#define CANDIES_API static
+#include "candies.h"
+
+#define PROGRAM_NAME "sock-diag"
+#define PROGRAM_URL  "https://github.com/domsson/candies/sock-diag"
+
+#define PROGRAM_VER_MAJOR 0
+#define PROGRAM_VER_MINOR 1
+#define PROGRAM_VER_PATCH 0
+
+#define DEFAULT_INTERVAL 1
+#define DEFAULT_FORMAT   "%e"
+
+#define NETLINK_BUFLEN 65536
+
+#define OUTPUT_SIZE 128
+#define RESULT_SIZE 16
+
+// TCP states as used by the kernel (include/net/tcp_states.h)
+#define TCP_ESTABLISHED  1
+#define TCP_SYN_SENT     2
+#define TCP_SYN_RECV     3
+#define TCP_FIN_WAIT1    4
+#define TCP_FIN_WAIT2    5
+#define TCP_TIME_WAIT    6
+#define TCP_CLOSE        7
+#define TCP_CLOSE_WAIT   8
+#define TCP_LAST_ACK     9
+#define TCP_LISTEN      10
+#define TCP_CLOSING     11
+#define TCP_STATES_NUM  12
+
+#define TCP_STATES_ALL  ((1 << TCP_STATES_NUM) - 1)
+
+typedef unsigned long ulong;
+typedef unsigned char byte;
+
+struct info
+{
+	ulong tcp[TCP_STATES_NUM]; // TCP sockets, per state
+	ulong tcp_total;           // TCP sockets, all (requested) states
+	ulong udp_total;           // UDP sockets
+};
+
+typedef struct info info_s;
+
+struct options
+{
+	byte monitor : 1;    // keep running and printing
+	byte continuous : 1; // keep printing even if output hasn't changed
+	byte ipv4 : 1;       // only look at IPv4 sockets
+	byte ipv6 : 1;       // only look at IPv6 sockets
+	byte help : 1;       // show help and exit
+	byte version : 1;    // show version info and exit
+	int interval;        // print every `interval` seconds
+	char *format;        // format string
+
+	// these will be set by the program
+	unsigned tcp_states; // TCP states to ask the kernel for (bitmask)
+	byte udp;            // whether we need to ask for UDP sockets at all
+};
+
+typedef struct options opts_s;
+
+struct context
+{
+	info_s *info;
+	opts_s *opts;
+	char buffer[RESULT_SIZE];
+	char output_prev[OUTPUT_SIZE];
+	char output_curr[OUTPUT_SIZE];
+};
+
+typedef struct context ctx_s;
+
+// Format specifiers and the TCP state they stand for
+static const char *tcp_specifiers = " esr12wcCalg";
+
+static void
+fetch_opts(opts_s *opts, int argc, char **argv)
+{
+	opterr = 0;
+	int o;
+	while ((o = getopt(argc, argv, "46f:hi:kmV")) != -1)
+	{
+		switch (o)
+		{
+			case '4':
+				opts->ipv4 = 1;
+				break;
+			case '6':
+				opts->ipv6 = 1;
+				break;
+			case 'f':
+				opts->format = optarg;
+				break;
+			case 'h':
+				opts->help = 1;
+				break;
+			case 'i':
+				opts->interval = atoi(optarg);
+				break;
+			case 'k':
+				opts->continuous = 1;
+				break;
+			case 'm':
+				opts->monitor = 1;
+				break;
+			case 'V':
+				opts->version = 1;
+				break;
+		}
+	}
+}
+
+/**
+ * Prints usage information.
+ */
+static void
+help(char *invocation, FILE* stream)
+{
+	fprintf(stream, "Usage:\n");
+     	fprintf(stream, "\t%s [OPTIONS...]\n", invocation);
+	fprintf(stream, "\n");
+	fprintf(stream, "Options:\n");
+	fprintf(stream, "\t-4 Only count IPv4 sockets\n");
+	fprintf(stream, "\t-6 Only count IPv6 sockets\n");
+	fprintf(stream, "\t-f Output format string; default is '%%e'\n");
+	fprintf(stream, "\t-h Print this help text and exit\n");
+	fprintf(stream, "\t-i Seconds between checking for a change in value; default is 1\n");
+	fprintf(stream, "\t-k Keep printing, even if the values haven't changed\n");
+	fprintf(stream, "\t-m Keep running and print when there is a change in value\n");
+	fprintf(stream, "\t-V Print version information and exit\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "Format specifiers:\n");
+	fprintf(stream, "\t%%e: TCP sockets in ESTABLISHED state\n");
+	fprintf(stream, "\t%%s: TCP sockets in SYN_SENT state\n");
+	fprintf(stream, "\t%%r: TCP sockets in SYN_RECV state\n");
+	fprintf(stream, "\t%%1: TCP sockets in FIN_WAIT1 state\n");
+	fprintf(stream, "\t%%2: TCP sockets in FIN_WAIT2 state\n");
+	fprintf(stream, "\t%%w: TCP sockets in TIME_WAIT state\n");
+	fprintf(stream, "\t%%c: TCP sockets in CLOSE state\n");
+	fprintf(stream, "\t%%C: TCP sockets in CLOSE_WAIT state\n");
+	fprintf(stream, "\t%%a: TCP sockets in LAST_ACK state\n");
+	fprintf(stream, "\t%%l: TCP sockets in LISTEN state\n");
+	fprintf(stream, "\t%%g: TCP sockets in CLOSING state\n");
+	fprintf(stream, "\t%%t: TCP sockets in any state\n");
+	fprintf(stream, "\t%%u: UDP sockets\n");
+}
+
+/*
+ * Print version information.
+ */
+static void
+version(FILE *stream)
+{
+	fprintf(stream, "%s %d.%d.%d\n%s\n", PROGRAM_NAME,
+			PROGRAM_VER_MAJOR, PROGRAM_VER_MINOR, PROGRAM_VER_PATCH,
+			PROGRAM_URL);
+}
+
+/*
+ * Figures out which TCP states we need to ask the kernel for, as well as
+ * whether we need to ask for UDP sockets at all, based on the format string.
+ * This way, the kernel only sends us the sockets we're actually counting.
+ */
+static void
+parse_format(opts_s *opts)
+{
+	const char *format = opts->format;
+	const char *state  = NULL;
+
+	for (; *format; ++format)
+	{
+		if (*format != '%' || format[1] == '\0')
+		{
+			continue;
+		}
+
+		++format;
+		if (*format == 't')
+		{
+			opts->tcp_states = TCP_STATES_ALL;
+		}
+		else if (*format == 'u')
+		{
+			opts->udp = 1;
+		}
+		else if (*format != ' ' && (state = strchr(tcp_specifiers, *format)))
+		{
+			opts->tcp_states |= 1 << (state - tcp_specifiers);
+		}
+	}
+}
+
+/*
+ * Sends a sock_diag dump request for the given family, protocol and states.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+diag_request(int fd, byte family, byte protocol, unsigned states, unsigned seq)
+{
+	struct
+	{
+		struct nlmsghdr nh;
+		struct inet_diag_req_v2 req;
+	}
+	msg = { 0 };
+
+	msg.nh.nlmsg_len   = sizeof(msg);
+	msg.nh.nlmsg_type  = SOCK_DIAG_BY_FAMILY;
+	msg.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	msg.nh.nlmsg_seq   = seq;
+
+	msg.req.sdiag_family   = family;
+	msg.req.sdiag_protocol = protocol;
+	msg.req.idiag_states   = states;
+	msg.req.idiag_ext      = 0; // we don't need any extensions (meminfo etc)
+
+	return send(fd, &msg, sizeof(msg), 0) == -1 ? -1 : 0;
+}
+
+/*
+ * Reads the reply to a previously sent dump request and counts the sockets
+ * per state into `counts`, which needs to have TCP_STATES_NUM elements.
+ * Returns the total number of sockets counted or -1 on error.
+ */
+static long
+diag_count(int fd, unsigned seq, ulong *counts)
+{
+	char buf[NETLINK_BUFLEN] __attribute__((aligned(NLMSG_ALIGNTO)));
+	long total = 0;
+
+	for (;;)
+	{
+		int len = recv(fd, buf, sizeof(buf), 0);
+		if (len == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (len <= 0)
+		{
+			return -1;
+		}
+
+		struct nlmsghdr *nh = (struct nlmsghdr*) buf;
+		for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+		{
+			if (nh->nlmsg_seq != seq)
+			{
+				continue;
+			}
+			if (nh->nlmsg_type == NLMSG_DONE)
+			{
+				return total;
+			}
+			if (nh->nlmsg_type == NLMSG_ERROR)
+			{
+				// the protocol might not be available (module not loaded)
+				struct nlmsgerr *err = NLMSG_DATA(nh);
+				return err->error == -ENOENT ? total : -1;
+			}
+			if (nh->nlmsg_type != SOCK_DIAG_BY_FAMILY)
+			{
+				continue;
+			}
+
+			struct inet_diag_msg *diag = NLMSG_DATA(nh);
+			if (diag->idiag_state < TCP_STATES_NUM)
+			{
+				++counts[diag->idiag_state];
+			}
+			++total;
+		}
+	}
+}
+
+/*
+ * Asks the kernel for all sockets of the given protocol in the given states,
+ * for all families we're interested in, and counts them.
+ * Returns the total number of sockets counted or -1 on error.
+ */
+static long
+diag_dump(int fd, opts_s *opts, byte protocol, unsigned states, ulong *counts)
+{
+	static unsigned seq = 0;
+
+	byte families[] = { AF_INET, AF_INET6 };
+	long total = 0;
+
+	for (size_t i = 0; i < sizeof(families); ++i)
+	{
+		if ((opts->ipv4 && families[i] != AF_INET) ||
+		    (opts->ipv6 && families[i] != AF_INET6))
+		{
+			continue;
+		}
+
+		if (diag_request(fd, families[i], protocol, states, ++seq) == -1)
+		{
+			return -1;
+		}
+
+		long num = diag_count(fd, seq, counts);
+		if (num == -1)
+		{
+			return -1;
+		}
+		total += num;
+	}
+
+	return total;
+}
+
+static int
+fetch_info(int fd, opts_s *opts, info_s *info)
+{
+	if (opts->tcp_states)
+	{
+		long num = diag_dump(fd, opts, IPPROTO_TCP, opts->tcp_states, info->tcp);
+		if (num == -1)
+		{
+			return -1;
+		}
+		info->tcp_total = num;
+	}
+
+	if (opts->udp)
+	{
+		ulong counts[TCP_STATES_NUM] = { 0 };
+		long num = diag_dump(fd, opts, IPPROTO_UDP, TCP_STATES_ALL, counts);
+		if (num == -1)
+		{
+			return -1;
+		}
+		info->udp_total = num;
+	}
+
+	return 0;
+}
+
+static char*
+candy_format_cb(char c, void* context)
+{
+	ctx_s* ctx = (ctx_s*) context;
+	const char *state = NULL;
+	ulong val = 0;
+
+	if (c == 't')
+	{
+		val = ctx->info->tcp_total;
+	}
+	else if (c == 'u')
+	{
+		val = ctx->info->udp_total;
+	}
+	else if (c != ' ' && (state = strchr(tcp_specifiers, c)))
+	{
+		val = ctx->info->tcp[state - tcp_specifiers];
+	}
+	else
+	{
+		return NULL;
+	}
+
+	snprintf(ctx->buffer, RESULT_SIZE, "%lu", val);
+	return ctx->buffer;
+}
+
+static void
+format_info(ctx_s* ctx)
+{
+	candy_format(ctx->opts->format, ctx->output_curr, OUTPUT_SIZE, candy_format_cb, ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+	opts_s opts = { 0 };
+	fetch_opts(&opts, argc, argv);
+
+	if (opts.help)
+	{
+		help(argv[0], stdout);
+		return EXIT_SUCCESS;
+	}
+
+	if (opts.version)
+	{
+		version(stdout);
+		return EXIT_SUCCESS;
+	}
+
+	// both given means we want both, same as none given
+	if (opts.ipv4 && opts.ipv6)
+	{
+		opts.ipv4 = 0;
+		opts.ipv6 = 0;
+	}
+
+	if (opts.interval == 0)
+	{
+		opts.interval = DEFAULT_INTERVAL;
+	}
+
+	// set interval to 0 if we don't monitor (run only once)
+	if (opts.monitor == 0)
+	{
+		opts.interval = 0;
+	}
+
+	// if not format given, use the default
+	if (opts.format == NULL)
+	{
+		opts.format = DEFAULT_FORMAT;
+	}
+
+	parse_format(&opts);
+
+	// the socket is kept open and reused for every dump
+	int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+	if (fd == -1)
+	{
+		return EXIT_FAILURE;
+	}
+
+	// make sure stdout is line buffered
+	setlinebuf(stdout);
+
+	// data structures we'll need from here on out
+	info_s info = { 0 };
+	ctx_s ctx = { .info = &info, .opts = &opts };
+
+	do
+	{
+		// zero out the gathered info from last iteration, if any
+		info = (const info_s) { 0 };
+
+		if (fetch_info(fd, &opts, &info) == -1)
+		{
+			close(fd);
+			return EXIT_FAILURE;
+		}
+
+		format_info(&ctx);
+
+		if (opts.continuous || strcmp(ctx.output_prev, ctx.output_curr) != 0)
+		{
+			fprintf(stdout, "%s\n", ctx.output_curr);
+		}
+
+		strcpy(ctx.output_prev, ctx.output_curr);
+
+		sleep(opts.interval);
+	}
+	while (opts.monitor);
+
+	close(fd);
+	return EXIT_SUCCESS;
+}
@@ -1,19 +1,40 @@
 #include <stdio.h>            // fprintf
 #include <stdlib.h>           // NULL, EXIT_*
-#include <unistd.h>           // getopt() et al.
-#include <string.h>           // strstr()
+#include <unistd.h>           // getopt() et al., pread(), close()
+#include <string.h>           // strstr(), strdup()
 #include <math.h>             // pow(), fabs()
 #include <float.h>            // DBL_MAX
+#include <limits.h>           // INT_MAX
+#include <fcntl.h>            // openat()
 #include <sys/types.h>        // opendir()
-#include <dirent.h>           // opendir(), readdir()
+#include <sys/stat.h>         // fstat()
+#include <dirent.h>           // opendir(), readdir(), fdopendir()
+#include "candies.h"
 
 #define UNIT_METRIC   "°C" 
 #define UNIT_IMPERIAL "°F"
 
 #define DEFAULT_INTERVAL  1
 #define DEFAULT_THRESHOLD 1
-#define DEFAULT_PATH      "/sys/class/hwmon"
+#define DEFAULT_ROOT      "/sys"
+#define DEFAULT_PATH      "/class/hwmon"
 #define DEFAULT_FILE      "hwmon"
+#define DEFAULT_THERMAL   "/class/thermal"
+#define DEFAULT_ZONE_FILE "thermal_zone"
+#define DEFAULT_CPU_PATH  "/devices/system/cpu"
+#define DEFAULT_FORMAT    "%t"
+
+#define RESULT_SIZE  16
+#define OUTPUT_SIZE  1024
+
+#define NAME_SIZE    64
+#define LABEL_SIZE   64
+#define VALUE_BUFLEN 16
+#define TRIP_SIZE    16
+#define MAX_SENSORS  9
+
+#define CACHE_ENV    "XDG_RUNTIME_DIR"
+#define CACHE_NAME   "temp-hwmon"
 
 struct config 
 {
@@ -22,263 +43,1759 @@ struct config
 	int unit : 1;           // also print the °C unit
 	int space : 1;          // space between val and unit
 	int imperial: 1;        // use fahrenheit (imperial)
+	int nocache : 1;        // don't use the discovery cache
+	int trips : 1;          // read trip points (format uses them)
+	int cooling : 1;        // read cooling devices (format uses them)
+	int throttle : 1;       // read throttle counters (format uses them)
+	int limits : 1;         // read max and crit limits (format uses them)
 	int precision;          // decimal places in output
+	int aggr;               // how to combine multiple readings
 	int interval;           // seconds between temp checks
-	double threshold;       // (not yet in use)
+	double threshold;       // required change in value in order to print
+	double hysteresis;      // additional drop required in order to print
+	double alpha;           // smoothing factor of the moving average
+	char *root;             // sysfs mount point, all paths are relative to it
 	char *path;             // path with hwmon entires
 	char *file;             // beginning of relevant file names in path
+	char *thermal;          // path with thermal zone entries
+	char *zone_file;        // beginning of thermal zone names in thermal
+	char *cpus;             // path with the CPU entries
 	char *unit_str;         // unit string to use
+	char *format;           // output format string
 	char *chip;	        // chip prefix to look for
 	char *feat;	        // feature label to look for
+	char *zone;             // thermal zone type to look for
+	char *sels[MAX_SENSORS];// sensor selectors (CHIP:ATTR)
+	size_t num_sels;
+};
+
+enum sensor_class
+{
+	CLASS_TEMP,             // tempN_*, millidegrees Celsius
+	CLASS_FAN,              // fanN_*, RPM
+	CLASS_IN,               // inN_*, millivolts
+	CLASS_POWER,            // powerN_*, microwatts
+	CLASS_CURR              // currN_*, milliamperes
+};
+
+struct sensor_info
+{
+	const char *prefix;     // attribute prefix in sysfs
+	double scale;           // divide by this to get the unit below
+	const char *unit;       // unit of the scaled value
+};
+
+static const struct sensor_info sensor_infos[] = {
+	{ "temp",  1000.0,    UNIT_METRIC },
+	{ "fan",   1.0,       "RPM" },
+	{ "in",    1000.0,    "V" },
+	{ "power", 1000000.0, "W" },
+	{ "curr",  1000.0,    "A" }
+};
+
+struct sensor
+{
+	char *chip;             // chip name to look for
+	char *attr;             // attribute file, like fan1_input
+	int class;              // see enum sensor_class
+	int num;                // N of the hwmonN the sensor was found in
+	int fd;                 // held-open attribute file
+	int ok;                 // did the last read succeed?
+	double val;             // current reading, scaled
+	double prev;            // reading last printed
+};
+
+struct trip
+{
+	char type[TRIP_SIZE];   // passive, active, hot, critical
+	int fd;                 // held-open trip_point_N_temp
+};
+
+struct cdev
+{
+	char name[NAME_SIZE];   // cooling_deviceN, to count each one once
+	long max;               // max_state (doesn't change)
+	int fd;                 // held-open cur_state
+};
+
+struct feature
+{
+	int index;              // N, as in tempN_input or thermal_zoneN
+	char *label;            // tempN_label, "tempN" or the zone's type
+	int fd;                 // held-open tempN_input or temp
+	double max;             // tempN_max or passive trip point, NAN if none
+	double crit;            // tempN_crit or critical trip point, NAN if none
+	struct trip *trips;     // trip points (thermal zones only)
+	size_t num_trips;
+};
+
+struct chip
+{
+	char entry[NAME_MAX+1]; // hwmon entry the chip was found in
+	struct feature *feats;  // matching features, ordered by index
+	size_t num_feats;
+	struct cdev *cdevs;     // cooling devices (thermal zones only)
+	size_t num_cdevs;
+	long cdevs_max;         // sum of all cooling devices' max_state
+};
+
+enum limit
+{
+	LIMIT_OK,               // below all limits
+	LIMIT_MAX,              // at or above the max limit
+	LIMIT_CRIT              // at or above the crit limit
+};
+
+enum aggregation
+{
+	AGGR_AVG,               // average of all readings
+	AGGR_MAX,               // highest reading
+	AGGR_MIN,               // lowest reading
+	AGGR_MEDIAN,            // median of all readings
+	AGGR_EACH               // all readings, one after the other
 };
 
-double to_fahrenheit(double celcius)
+struct temps
+{
+	double *vals;           // current readings, in feature order
+	double *sorted;         // scratch space for the median
+	double *prev;           // readings (or aggregate) last printed
+	double *ema;            // moving average per feature, NAN until first read
+	size_t num;             // number of current readings
+	size_t prev_num;        // number of values in prev
+	size_t size;            // capacity of the arrays above
+	double avg;
+	double max;
+	double min;
+	double median;
+	double trip_dist;       // distance to the closest trip point ahead
+	double trip_temp;       // temperature of that trip point
+	const char *trip_type;  // type of that trip point, NULL if none
+	long cooling;           // sum of the cooling devices' cur_state
+	long cooling_prev;      // cooling last printed
+	double headroom;        // smallest distance to a max (or crit) limit
+	int limit;              // highest limit reached, see enum limit
+};
+
+struct throttle
+{
+	int *fds;               // held-open throttle counters
+	long *ids;              // core/package each counter belongs to
+	size_t num;
+	int read : 1;           // have the counters been read before?
+	unsigned long total;    // sum of all counters
+	unsigned long delta;    // increase since the previous check
+	unsigned long total_prev; // total last printed
+	unsigned long delta_prev; // delta last printed
+};
+
+struct context
+{
+	struct config *cfg;
+	struct temps *temps;
+	struct sensor *sensors;
+	size_t num_sensors;
+	long cooling_max;
+	struct throttle *throttle;
+	char buffer[OUTPUT_SIZE];
+};
+
+double to_fahrenheit(double celcius)
+{
+	return (celcius * 1.8) + 32;
+}
+
+/**
+ * Reads the first line of a small (sysfs) file, relative to the directory
+ * `dir`, into `buf`, without the trailing newline. Returns 0 on success, 
+ * -1 on error.
+ */
+int read_line(int dir, const char *file, char *buf, size_t len)
+{
+	int fd = openat(dir, file, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		return -1;
+	}
+
+	ssize_t n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+	{
+		return -1;
+	}
+
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/**
+ * Reads a number from the given (held-open) sysfs file. 
+ * Returns 0 on success, -1 on error.
+ */
+int read_long(int fd, long *val)
+{
+	char buf[VALUE_BUFLEN];
+	ssize_t n = pread(fd, buf, VALUE_BUFLEN - 1, 0);
+	if (n <= 0)
+	{
+		return -1;
+	}
+
+	buf[n] = '\0';
+	*val = strtol(buf, NULL, 10);
+	return 0;
+}
+
+/**
+ * Reads the temperature from the given (held-open) tempN_input file, which
+ * reports it in millidegrees Celsius. Thermal zones and their trip points 
+ * use the same unit. Returns 0 on success, -1 on error.
+ */
+int read_temp(int fd, double *temp)
+{
+	long val;
+	if (read_long(fd, &val) == -1)
+	{
+		return -1;
+	}
+
+	*temp = val / 1000.0;
+	return 0;
+}
+
+/**
+ * Opens the directory of the given hwmon entry that holds its attributes.
+ * Usually, that's the entry itself, but older drivers place them in the 
+ * `device` subdirectory. Returns the directory's fd on success, -1 on error.
+ */
+int open_chip_dir(int hwmon, const char *entry)
+{
+	int dir = openat(hwmon, entry, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir == -1 || faccessat(dir, "name", R_OK, 0) == 0)
+	{
+		return dir;
+	}
+
+	int dev = openat(dir, "device", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	close(dir);
+	return dev;
+}
+
+/**
+ * Reads the target of the chip directory's `device` symlink into `buf`. 
+ * Virtual devices don't have one, in which case `buf` will be empty.
+ */
+void read_device_link(int dir, char *buf, size_t len)
+{
+	ssize_t n = readlinkat(dir, "device", buf, len - 1);
+	buf[n > 0 ? n : 0] = '\0';
+}
+
+/**
+ * Appends a feature to the chip's list of features. The feature takes 
+ * ownership of `fd`, even if this fails. Returns 0 on success, -1 on error.
+ */
+int add_feature(struct chip *chip, int index, const char *label, int fd)
+{
+	struct feature *feats = realloc(chip->feats, sizeof(struct feature) * (chip->num_feats + 1));
+	if (feats == NULL)
+	{
+		close(fd);
+		return -1;
+	}
+	chip->feats = feats;
+
+	struct feature *f = &chip->feats[chip->num_feats];
+	f->index = index;
+	f->label = strdup(label);
+	f->fd = fd;
+	f->trips = NULL;
+	f->num_trips = 0;
+	f->max = NAN;
+	f->crit = NAN;
+	if (f->label == NULL)
+	{
+		close(fd);
+		return -1;
+	}
+	++chip->num_feats;
+	return 0;
+}
+
+/**
+ * Reads the max and crit limits (tempN_max, tempN_crit) of the feature from 
+ * the chip directory `dir`, if the chip provides them. Limits rarely change, 
+ * so they're only read once.
+ */
+void load_limits(int dir, struct feature *feat)
+{
+	char file[NAME_SIZE];
+	char line[VALUE_BUFLEN];
+
+	snprintf(file, NAME_SIZE, "temp%d_max", feat->index);
+	if (read_line(dir, file, line, VALUE_BUFLEN) == 0)
+	{
+		feat->max = strtol(line, NULL, 10) / 1000.0;
+	}
+
+	snprintf(file, NAME_SIZE, "temp%d_crit", feat->index);
+	if (read_line(dir, file, line, VALUE_BUFLEN) == 0)
+	{
+		feat->crit = strtol(line, NULL, 10) / 1000.0;
+	}
+}
+
+int compare_features(const void *a, const void *b)
+{
+	return ((const struct feature *) a)->index - ((const struct feature *) b)->index;
+}
+
+/**
+ * Finds all temperature features (tempN_input files) of the chip in the 
+ * directory `dir` whose label contains `feat` (all, if `feat` is NULL). 
+ * Features without a tempN_label file are labelled "tempN". The input files
+ * of all matching features are opened and stay open, so they can be re-read
+ * without walking the directory again. Their limits are only read if 
+ * `limits` is set. Returns 0 on success, -1 on error.
+ */
+int load_features(int dir, struct chip *chip, const char *feat, int limits)
+{
+	DIR *chipdir = fdopendir(dup(dir));
+	if (chipdir == NULL)
+	{
+		return -1;
+	}
+
+	// the duplicate shares the offset with `dir`, which might have been read
+	rewinddir(chipdir);
+
+	struct dirent *entry = NULL;
+	char file[NAME_SIZE];
+	char label[LABEL_SIZE];
+	int index;
+	int len;
+
+	while ((entry = readdir(chipdir)))
+	{
+		// exactly "temp<N>_input", hence the check for nothing after it
+		len = 0;
+		if (sscanf(entry->d_name, "temp%d_input%n", &index, &len) != 1 || len == 0 || entry->d_name[len] != '\0')
+		{
+			continue;
+		}
+
+		snprintf(file, NAME_SIZE, "temp%d_label", index);
+		if (read_line(dir, file, label, LABEL_SIZE) == -1)
+		{
+			snprintf(label, LABEL_SIZE, "temp%d", index);
+		}
+
+		// not a feature the user is interested in
+		if (feat && strstr(label, feat) == NULL)
+		{
+			continue;
+		}
+
+		int fd = openat(dir, entry->d_name, O_RDONLY | O_CLOEXEC);
+		if (fd == -1 || add_feature(chip, index, label, fd) == -1)
+		{
+			closedir(chipdir);
+			return -1;
+		}
+		if (limits)
+		{
+			load_limits(dir, &chip->feats[chip->num_feats - 1]);
+		}
+	}
+
+	closedir(chipdir);
+
+	// directory order is arbitrary, but "temp1" should come before "temp2"
+	qsort(chip->feats, chip->num_feats, sizeof(struct feature), compare_features);
+	return 0;
+}
+
+void free_chip(struct chip *chip)
+{
+	for (size_t i = 0; i < chip->num_feats; ++i)
+	{
+		for (size_t t = 0; t < chip->feats[i].num_trips; ++t)
+		{
+			close(chip->feats[i].trips[t].fd);
+		}
+		free(chip->feats[i].trips);
+		close(chip->feats[i].fd);
+		free(chip->feats[i].label);
+	}
+	for (size_t i = 0; i < chip->num_cdevs; ++i)
+	{
+		close(chip->cdevs[i].fd);
+	}
+	free(chip->feats);
+	free(chip->cdevs);
+	*chip = (struct chip) { 0 };
+}
+
+/**
+ * Goes through the hwmon entries and looks for the chip whose name contains
+ * `prefix`. If several match, the one with the lowest hwmon number wins, 
+ * just like with the order in which libsensors reports them. Then loads the
+ * chip's features that match `feat`. Returns 0 if the chip was found, -1 
+ * otherwise.
+ */
+int find_chip(struct config *cfg, const char *prefix, const char *feat, struct chip *chip)
+{
+	DIR *hwmon = opendir(cfg->path);
+	if (hwmon == NULL)
+	{
+		return -1;
+	}
+
+	struct dirent *entry = NULL;
+	char name[NAME_SIZE];
+	char found[NAME_MAX + 1] = { 0 };
+	int found_num = INT_MAX;
+	size_t file_len = strlen(cfg->file);
+
+	while ((entry = readdir(hwmon)))
+	{
+		// Skipping everything that doesn't start with "hwmon"
+		// or whatever else is in the config's 'file' field 
+		if (strncmp(entry->d_name, cfg->file, file_len) != 0)
+		{
+			continue;
+		}
+
+		int num = atoi(entry->d_name + file_len);
+		if (num >= found_num)
+		{
+			continue;
+		}
+
+		int dir = open_chip_dir(dirfd(hwmon), entry->d_name);
+		if (dir == -1)
+		{
+			continue;
+		}
+
+		if (read_line(dir, "name", name, NAME_SIZE) == 0 && strstr(name, prefix))
+		{
+			snprintf(found, sizeof(found), "%s", entry->d_name);
+			found_num = num;
+		}
+		close(dir);
+	}
+
+	int dir = found[0] ? open_chip_dir(dirfd(hwmon), found) : -1;
+	closedir(hwmon);
+	if (dir == -1)
+	{
+		return -1;
+	}
+
+	snprintf(chip->entry, sizeof(chip->entry), "%s", found);
+
+	int ret = load_features(dir, chip, feat, cfg->limits);
+	close(dir);
+	return ret;
+}
+
+/**
+ * Opens all trip points (trip_point_N_temp) of the thermal zone in `dir` and
+ * adds them to the feature. Returns 0 on success, -1 on error.
+ */
+int load_trips(int dir, struct feature *feat)
+{
+	char file[NAME_SIZE];
+
+	for (int n = 0; ; ++n)
+	{
+		snprintf(file, NAME_SIZE, "trip_point_%d_temp", n);
+		int fd = openat(dir, file, O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+		{
+			// trip points are numbered without gaps
+			return 0;
+		}
+
+		struct trip *trips = realloc(feat->trips, sizeof(struct trip) * (feat->num_trips + 1));
+		if (trips == NULL)
+		{
+			close(fd);
+			return -1;
+		}
+		feat->trips = trips;
+
+		struct trip *trip = &feat->trips[feat->num_trips++];
+		trip->fd = fd;
+		snprintf(file, NAME_SIZE, "trip_point_%d_type", n);
+		if (read_line(dir, file, trip->type, TRIP_SIZE) == -1)
+		{
+			snprintf(trip->type, TRIP_SIZE, "?");
+		}
+
+		// passive cooling (throttling) is what max is for hwmon chips
+		double temp;
+		if (read_temp(fd, &temp) == 0)
+		{
+			if (strcmp(trip->type, "passive") == 0 && !(temp >= feat->max))
+			{
+				feat->max = temp;
+			}
+			if (strcmp(trip->type, "critical") == 0)
+			{
+				feat->crit = temp;
+			}
+		}
+	}
+}
+
+/**
+ * Opens the state of all cooling devices bound to the thermal zone in `dir`
+ * (via its cdevN links) and adds them to the chip. A cooling device can be
+ * bound to several trip points or zones, but will only be added once.
+ * Returns 0 on success, -1 on error.
+ */
+int load_cdevs(int dir, struct chip *chip)
+{
+	char link[NAME_SIZE];
+	char file[NAME_SIZE * 2];
+	char line[VALUE_BUFLEN];
+
+	for (int n = 0; ; ++n)
+	{
+		snprintf(file, sizeof(file), "cdev%d", n);
+		ssize_t len = readlinkat(dir, file, link, NAME_SIZE - 1);
+		if (len <= 0)
+		{
+			// cooling device links are numbered without gaps
+			return 0;
+		}
+		link[len] = '\0';
+
+		char *name = strrchr(link, '/');
+		name = name ? name + 1 : link;
+
+		int known = 0;
+		for (size_t c = 0; c < chip->num_cdevs && !known; ++c)
+		{
+			known = strcmp(chip->cdevs[c].name, name) == 0;
+		}
+		if (known)
+		{
+			continue;
+		}
+
+		snprintf(file, sizeof(file), "cdev%d/max_state", n);
+		if (read_line(dir, file, line, VALUE_BUFLEN) == -1)
+		{
+			continue;
+		}
+
+		snprintf(file, sizeof(file), "cdev%d/cur_state", n);
+		int fd = openat(dir, file, O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+		{
+			continue;
+		}
+
+		struct cdev *cdevs = realloc(chip->cdevs, sizeof(struct cdev) * (chip->num_cdevs + 1));
+		if (cdevs == NULL)
+		{
+			close(fd);
+			return -1;
+		}
+		chip->cdevs = cdevs;
+
+		struct cdev *cdev = &chip->cdevs[chip->num_cdevs++];
+		snprintf(cdev->name, NAME_SIZE, "%s", name);
+		cdev->max = strtol(line, NULL, 10);
+		cdev->fd = fd;
+		chip->cdevs_max += cdev->max;
+	}
+}
+
+/**
+ * Goes through the thermal zones and adds all whose type contains `type` 
+ * as features of `chip`, including their trip points and cooling devices.
+ * Returns 0 on success, -1 on error.
+ */
+int find_zones(struct config *cfg, const char *type, struct chip *chip)
+{
+	DIR *thermal = opendir(cfg->thermal);
+	if (thermal == NULL)
+	{
+		return -1;
+	}
+
+	struct dirent *entry = NULL;
+	char name[LABEL_SIZE];
+	size_t file_len = strlen(cfg->zone_file);
+
+	while ((entry = readdir(thermal)))
+	{
+		// Skipping everything that isn't a thermal zone, 
+		// like the cooling devices that are in here as well
+		if (strncmp(entry->d_name, cfg->zone_file, file_len) != 0)
+		{
+			continue;
+		}
+
+		int dir = openat(dirfd(thermal), entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dir == -1)
+		{
+			continue;
+		}
+
+		if (read_line(dir, "type", name, LABEL_SIZE) == -1 || strstr(name, type) == NULL)
+		{
+			close(dir);
+			continue;
+		}
+
+		int fd = openat(dir, "temp", O_RDONLY | O_CLOEXEC);
+		if (fd == -1 || add_feature(chip, atoi(entry->d_name + file_len), name, fd) == -1 ||
+		    load_trips(dir, &chip->feats[chip->num_feats - 1]) == -1 ||
+		    load_cdevs(dir, chip) == -1)
+		{
+			close(dir);
+			closedir(thermal);
+			return -1;
+		}
+		close(dir);
+	}
+
+	closedir(thermal);
+
+	// directory order is arbitrary, but "thermal_zone1" should come first
+	qsort(chip->feats, chip->num_feats, sizeof(struct feature), compare_features);
+	return 0;
+}
+
+/**
+ * Determines the class of a sensor from the name of its attribute file, 
+ * like `fan1_input`. Returns the class, or -1 if the attribute isn't one 
+ * of the supported sensor classes.
+ */
+int parse_class(const char *attr)
+{
+	for (int c = 0; c < (int) (sizeof(sensor_infos) / sizeof(sensor_infos[0])); ++c)
+	{
+		size_t len = strlen(sensor_infos[c].prefix);
+		if (strncmp(attr, sensor_infos[c].prefix, len) == 0 && 
+		    attr[len] >= '0' && attr[len] <= '9')
+		{
+			return c;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Sets up `sensor` from the given selector of the form CHIP:ATTR, which will 
+ * be modified in the process. Returns 0 on success, -1 if the selector is
+ * malformed or refers to an unsupported attribute.
+ */
+int parse_sensor(char *sel, struct sensor *sensor)
+{
+	char *sep = strrchr(sel, ':');
+	if (sep == NULL || sep == sel || sep[1] == '\0')
+	{
+		return -1;
+	}
+	*sep = '\0';
+
+	*sensor = (struct sensor) { .chip = sel, .attr = sep + 1, .num = INT_MAX, .fd = -1, .prev = -DBL_MAX };
+	sensor->class = parse_class(sensor->attr);
+	if (sensor->class == -1)
+	{
+		*sep = ':';
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Goes through the hwmon entries once and opens the attribute file of every 
+ * sensor on the first (lowest numbered) chip whose name contains the sensor's
+ * chip name. Returns 0 if all sensors were found, -1 otherwise.
+ */
+int find_sensors(struct config *cfg, struct sensor *sensors, size_t num)
+{
+	DIR *hwmon = opendir(cfg->path);
+	if (hwmon == NULL)
+	{
+		return -1;
+	}
+
+	struct dirent *entry = NULL;
+	char name[NAME_SIZE];
+	size_t file_len = strlen(cfg->file);
+
+	while ((entry = readdir(hwmon)))
+	{
+		if (strncmp(entry->d_name, cfg->file, file_len) != 0)
+		{
+			continue;
+		}
+
+		int dir = open_chip_dir(dirfd(hwmon), entry->d_name);
+		if (dir == -1)
+		{
+			continue;
+		}
+
+		if (read_line(dir, "name", name, NAME_SIZE) == -1)
+		{
+			close(dir);
+			continue;
+		}
+
+		int n = atoi(entry->d_name + file_len);
+		for (size_t s = 0; s < num; ++s)
+		{
+			if (n > sensors[s].num || strstr(name, sensors[s].chip) == NULL)
+			{
+				continue;
+			}
+
+			int fd = openat(dir, sensors[s].attr, O_RDONLY | O_CLOEXEC);
+			if (fd == -1)
+			{
+				continue;
+			}
+
+			if (sensors[s].fd != -1)
+			{
+				close(sensors[s].fd);
+			}
+			sensors[s].fd = fd;
+			sensors[s].num = n;
+		}
+		close(dir);
+	}
+
+	closedir(hwmon);
+
+	for (size_t s = 0; s < num; ++s)
+	{
+		if (sensors[s].fd == -1)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void free_sensors(struct sensor *sensors, size_t num)
+{
+	for (size_t s = 0; s < num; ++s)
+	{
+		if (sensors[s].fd != -1)
+		{
+			close(sensors[s].fd);
+		}
+	}
+}
+
+/**
+ * Scales a raw sensor reading to the unit of its class (and converts 
+ * temperatures to Fahrenheit, if requested).
+ */
+double scale_sensor(int class, long raw, struct config *cfg)
+{
+	double val = raw / sensor_infos[class].scale;
+	return class == CLASS_TEMP && cfg->imperial ? to_fahrenheit(val) : val;
+}
+
+/**
+ * Formats a sensor reading according to precision and the unit of its class.
+ */
+void format_sensor(char *buf, size_t len, int class, double val, struct config *cfg)
+{
+	const char *unit = class == CLASS_TEMP ? cfg->unit_str : 
+		(cfg->unit ? sensor_infos[class].unit : "");
+	snprintf(buf, len, "%.*f%s%s", cfg->precision, val, 
+			cfg->space && cfg->unit ? " " : "", unit);
+}
+
+/**
+ * Reads all sensors, one pread() each.
+ */
+void read_sensors(struct sensor *sensors, size_t num, struct config *cfg)
+{
+	long raw;
+	for (size_t s = 0; s < num; ++s)
+	{
+		sensors[s].ok = read_long(sensors[s].fd, &raw) == 0;
+		sensors[s].val = sensors[s].ok ? scale_sensor(sensors[s].class, raw, cfg) : 0.0;
+	}
+}
+
+/**
+ * Checks whether any of the sensor readings changed enough since the last 
+ * time they were printed. If so, remembers them as printed and returns 1, 
+ * otherwise returns 0.
+ */
+int sensors_changed(struct sensor *sensors, size_t num, double threshold)
+{
+	int changed = 0;
+	for (size_t s = 0; s < num && !changed; ++s)
+	{
+		changed = fabs(sensors[s].val - sensors[s].prev) >= threshold;
+	}
+
+	for (size_t s = 0; s < num && changed; ++s)
+	{
+		sensors[s].prev = sensors[s].val;
+	}
+	return changed;
+}
+
+/**
+ * Builds the path of the discovery cache file for the current chip and 
+ * feature selection in `buf`. As hwmon numbering can change between boots, 
+ * but the runtime directory is emptied on every boot as well, this is where 
+ * the cache goes. Returns 0 on success, -1 if there is no runtime directory.
+ */
+int cache_path(struct config *cfg, char *buf, size_t len)
+{
+	const char *dir = getenv(CACHE_ENV);
+	if (dir == NULL || dir[0] == '\0')
+	{
+		return -1;
+	}
+
+	// djb2, to give every selection its own small cache file
+	unsigned long hash = 5381;
+	const char *keys[] = { cfg->path, cfg->chip, cfg->feat };
+	for (size_t k = 0; k < 3; ++k)
+	{
+		for (const char *c = keys[k]; *c; ++c)
+		{
+			hash = ((hash << 5) + hash) + (unsigned char) *c;
+		}
+		hash = ((hash << 5) + hash) + '\t';
+	}
+
+	return snprintf(buf, len, "%s/%s-%08lx.cache", dir, CACHE_NAME, hash & 0xffffffff) < (int) len ? 0 : -1;
+}
+
+/**
+ * Tries to load the chip's matching features from the discovery cache. Every
+ * cached entry is validated: the chip directory's `device` link has to point
+ * to the same device as before, and every input file has to be the same file
+ * (inode) as the one that was found during the scan. That's one open() per 
+ * feature instead of a full scan. Returns 0 on success, -1 if there is no 
+ * (valid) cache for the current selection.
+ */
+int load_cache(struct config *cfg, struct chip *chip)
+{
+	char path[PATH_MAX];
+	if (cache_path(cfg, path, sizeof(path)) == -1)
+	{
+		return -1;
+	}
+
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+
+	char line[PATH_MAX];
+	char key[PATH_MAX];
+	char link[PATH_MAX];
+	char label[LABEL_SIZE];
+	unsigned long ino;
+	int index;
+	int num;
+	int hwmon = -1;
+	int dir = -1;
+	struct stat st;
+
+	// First line: the selection (rules out hash collisions)
+	snprintf(key, sizeof(key), "%s\t%s\t%s\n", cfg->path, cfg->chip, cfg->feat);
+	if (fgets(line, sizeof(line), fp) == NULL || strcmp(line, key) != 0)
+	{
+		goto invalid;
+	}
+
+	// Second line: the hwmon entry and its device link
+	if (fgets(line, sizeof(line), fp) == NULL)
+	{
+		goto invalid;
+	}
+	line[strcspn(line, "\n")] = '\0';
+	char *sep = strchr(line, '\t');
+	if (sep == NULL)
+	{
+		goto invalid;
+	}
+	*sep = '\0';
+
+	hwmon = open(cfg->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	dir = hwmon == -1 ? -1 : open_chip_dir(hwmon, line);
+	if (dir == -1)
+	{
+		goto invalid;
+	}
+
+	read_device_link(dir, link, sizeof(link));
+	if (strcmp(link, sep + 1) != 0 || sep - line >= (long) sizeof(chip->entry))
+	{
+		goto invalid;
+	}
+	memcpy(chip->entry, line, sep - line + 1);
+
+	// Remaining lines: one feature each
+	while (fgets(line, sizeof(line), fp))
+	{
+		line[strcspn(line, "\n")] = '\0';
+		if (sscanf(line, "%d\t%lu\t%n", &index, &ino, &num) != 2)
+		{
+			goto invalid;
+		}
+		snprintf(label, LABEL_SIZE, "%s", line + num);
+
+		snprintf(key, sizeof(key), "temp%d_input", index);
+		int fd = openat(dir, key, O_RDONLY | O_CLOEXEC);
+		if (fd == -1 || fstat(fd, &st) == -1 || st.st_ino != ino)
+		{
+			if (fd != -1)
+			{
+				close(fd);
+			}
+			goto invalid;
+		}
+
+		if (add_feature(chip, index, label, fd) == -1)
+		{
+			goto invalid;
+		}
+		if (cfg->limits)
+		{
+			load_limits(dir, &chip->feats[chip->num_feats - 1]);
+		}
+	}
+
+	if (chip->num_feats == 0)
+	{
+		goto invalid;
+	}
+
+	close(dir);
+	close(hwmon);
+	fclose(fp);
+	return 0;
+
+invalid:
+	if (dir != -1)
+	{
+		close(dir);
+	}
+	if (hwmon != -1)
+	{
+		close(hwmon);
+	}
+	fclose(fp);
+	free_chip(chip);
+	return -1;
+}
+
+/**
+ * Writes the chip's matching features to the discovery cache. The file is 
+ * written to a temporary file first and then renamed, so that concurrently
+ * running instances never see a partial cache. Returns 0 on success, -1 on 
+ * error.
+ */
+int save_cache(struct config *cfg, struct chip *chip)
+{
+	char path[PATH_MAX];
+	char temp[PATH_MAX];
+	char link[PATH_MAX];
+	struct stat st;
+
+	if (cache_path(cfg, path, sizeof(path)) == -1)
+	{
+		return -1;
+	}
+
+	// Tabs or newlines in the selection would break our simple format
+	if (strpbrk(cfg->chip, "\t\n") || strpbrk(cfg->feat, "\t\n"))
+	{
+		return -1;
+	}
+
+	int hwmon = open(cfg->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	int dir = hwmon == -1 ? -1 : open_chip_dir(hwmon, chip->entry);
+	if (hwmon != -1)
+	{
+		close(hwmon);
+	}
+	if (dir == -1)
+	{
+		return -1;
+	}
+	read_device_link(dir, link, sizeof(link));
+	close(dir);
+
+	if (snprintf(temp, sizeof(temp), "%s.%d", path, (int) getpid()) >= (int) sizeof(temp))
+	{
+		return -1;
+	}
+
+	FILE *fp = fopen(temp, "w");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+
+	fprintf(fp, "%s\t%s\t%s\n", cfg->path, cfg->chip, cfg->feat);
+	fprintf(fp, "%s\t%s\n", chip->entry, link);
+	for (size_t f = 0; f < chip->num_feats; ++f)
+	{
+		if (fstat(chip->feats[f].fd, &st) == -1)
+		{
+			fclose(fp);
+			unlink(temp);
+			return -1;
+		}
+		fprintf(fp, "%d\t%lu\t%s\n", chip->feats[f].index, (unsigned long) st.st_ino, chip->feats[f].label);
+	}
+
+	if (fclose(fp) != 0 || rename(temp, path) == -1)
+	{
+		unlink(temp);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Prints a single temperature reading, as part of the chip/zone listing.
+ * Temperature readings will be formatted according to precision and unit.
+ */
+void list_temp(char type, size_t num, const char *label, int fd, struct config *cfg)
+{
+	double temp;
+	if (read_temp(fd, &temp) == 0)
+	{
+		fprintf(stdout, " '-[%c%zu] %s (%.*f%s%s)\n", type, num, label,
+			cfg->precision, 
+			cfg->imperial ? to_fahrenheit(temp) : temp,
+			cfg->space && cfg->unit ? " " : "",
+			cfg->unit_str);
+	}
+	else
+	{
+		fprintf(stdout, " '-[%c%zu] %s (n/a)\n", type, num, label);
+	}
+}
+
+/**
+ * List all temperature features of the provided chip, including their readings.
+ * Temperature readings will be formatted according to precision and unit.
+ */
+void list_features(struct chip *chip, struct config *cfg)
+{
+	for (size_t f = 0; f < chip->num_feats; ++f)
+	{
+		list_temp('F', f, chip->feats[f].label, chip->feats[f].fd, cfg);
+	}
+}
+
+/**
+ * List all non-temperature sensors (fans, voltages, power, current) of the 
+ * chip in `dir`, including their readings. They are listed by their 
+ * attribute file name, as that's what `-S` expects.
+ */
+void list_sensors(int dir, struct config *cfg)
+{
+	DIR *chipdir = fdopendir(dup(dir));
+	if (chipdir == NULL)
+	{
+		return;
+	}
+	rewinddir(chipdir);
+
+	struct dirent *entry = NULL;
+	char file[NAME_MAX + 1];
+	char label[LABEL_SIZE];
+	char value[RESULT_SIZE];
+	long raw;
+
+	while ((entry = readdir(chipdir)))
+	{
+		int class = parse_class(entry->d_name);
+		char *suffix = strchr(entry->d_name, '_');
+		if (class <= CLASS_TEMP || suffix == NULL || 
+		    (strcmp(suffix, "_input") != 0 && strcmp(suffix, "_average") != 0))
+		{
+			continue;
+		}
+
+		// fan1_input has its label in fan1_label, if there is one
+		snprintf(file, sizeof(file), "%.*s_label", (int) (suffix - entry->d_name), entry->d_name);
+		if (read_line(dir, file, label, LABEL_SIZE) == -1)
+		{
+			snprintf(label, LABEL_SIZE, "%.*s", (int) (suffix - entry->d_name), entry->d_name);
+		}
+
+		int fd = openat(dir, entry->d_name, O_RDONLY | O_CLOEXEC);
+		if (fd != -1 && read_long(fd, &raw) == 0)
+		{
+			format_sensor(value, RESULT_SIZE, class, scale_sensor(class, raw, cfg), cfg);
+			fprintf(stdout, " '-[%s] %s (%s)\n", entry->d_name, label, value);
+		}
+		else
+		{
+			fprintf(stdout, " '-[%s] %s (n/a)\n", entry->d_name, label);
+		}
+
+		if (fd != -1)
+		{
+			close(fd);
+		}
+	}
+
+	closedir(chipdir);
+}
+
+/**
+ * List all thermal zones, including their readings, trip points and the 
+ * cooling devices bound to them.
+ */
+void list_zones(struct config *cfg)
+{
+	struct chip zones = { 0 };
+	if (find_zones(cfg, "", &zones) == -1)
+	{
+		free_chip(&zones);
+		return;
+	}
+
+	for (size_t z = 0; z < zones.num_feats; ++z)
+	{
+		struct feature *zone = &zones.feats[z];
+		fprintf(stdout, "[Z%zu] %s (from %s/%s%d)\n", z, zone->label, 
+				cfg->thermal, cfg->zone_file, zone->index);
+		list_temp('F', 0, "temp", zone->fd, cfg);
+
+		for (size_t t = 0; t < zone->num_trips; ++t)
+		{
+			list_temp('T', t, zone->trips[t].type, zone->trips[t].fd, cfg);
+		}
+	}
+
+	long state;
+	for (size_t c = 0; c < zones.num_cdevs; ++c)
+	{
+		fprintf(stdout, "[D%zu] %s (%ld/%ld)\n", c, zones.cdevs[c].name,
+				read_long(zones.cdevs[c].fd, &state) == 0 ? state : 0,
+				zones.cdevs[c].max);
+	}
+
+	free_chip(&zones);
+}
+
+/**
+ * Prints all detected chips and their features to stdout.
+ */
+int list_chips_and_features(struct config *cfg)
+{
+	DIR *hwmon = opendir(cfg->path);
+	
+	if (hwmon == NULL)
+	{
+		return -1;
+	}
+
+	struct dirent *entry = NULL;
+	char name[NAME_SIZE];
+	size_t c = 0;
+	size_t file_len = strlen(cfg->file);
+	
+	while ((entry = readdir(hwmon)))
+	{
+		// Skipping everything that doesn't start with "hwmon"
+		// or whatever else is in the config's 'file' field 
+		if (strncmp(entry->d_name, cfg->file, file_len) != 0)
+		{
+			continue;
+		}
+
+		int dir = open_chip_dir(dirfd(hwmon), entry->d_name);
+		if (dir == -1)
+		{
+			continue;
+		}
+
+		if (read_line(dir, "name", name, NAME_SIZE) == -1)
+		{
+			close(dir);
+			continue;
+		}
+
+		// Print the chip name, then all its features
+		fprintf(stdout, "[C%zu] %s (from %s/%s)\n", c, name, cfg->path, entry->d_name);
+		++c;
+
+		struct chip chip = { 0 };
+		if (load_features(dir, &chip, NULL, 0) == 0)
+		{
+			list_features(&chip, cfg);
+		}
+		list_sensors(dir, cfg);
+		free_chip(&chip);
+		close(dir);
+	}
+
+	closedir(hwmon);
+
+	// Thermal zones aren't chips, but might be all there is
+	list_zones(cfg);
+	return 0;
+}
+
+/**
+ * Opens the thermal throttle counters of all CPUs. Logical CPUs that share a
+ * core report the same core counter, and all CPUs of a package report the 
+ * same package counter, so each of those is only opened once. Returns 0 on
+ * success, -1 on error.
+ */
+int load_throttle(const char *path, struct throttle *th)
+{
+	DIR *cpus = opendir(path);
+	if (cpus == NULL)
+	{
+		return -1;
+	}
+
+	const char *files[] = {
+		"thermal_throttle/core_throttle_count",
+		"thermal_throttle/package_throttle_count"
+	};
+
+	struct dirent *entry = NULL;
+	char line[VALUE_BUFLEN];
+	int cpu;
+	int len;
+
+	while ((entry = readdir(cpus)))
+	{
+		// exactly "cpu<N>", not "cpufreq" or "cpuidle"
+		len = 0;
+		if (sscanf(entry->d_name, "cpu%d%n", &cpu, &len) != 1 || entry->d_name[len] != '\0')
+		{
+			continue;
+		}
+
+		int dir = openat(dirfd(cpus), entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dir == -1)
+		{
+			continue;
+		}
+
+		long package = read_line(dir, "topology/physical_package_id", line, VALUE_BUFLEN) == 0 ?
+			strtol(line, NULL, 10) : 0;
+		long core = read_line(dir, "topology/core_id", line, VALUE_BUFLEN) == 0 ?
+			strtol(line, NULL, 10) : cpu;
+
+		// the package counter is tracked as core -1 of its package
+		long ids[] = { (package << 21) | (core + 1), package << 21 };
+
+		for (size_t k = 0; k < 2; ++k)
+		{
+			int known = 0;
+			for (size_t i = 0; i < th->num && !known; ++i)
+			{
+				known = th->ids[i] == ids[k];
+			}
+			if (known)
+			{
+				continue;
+			}
+
+			int fd = openat(dir, files[k], O_RDONLY | O_CLOEXEC);
+			if (fd == -1)
+			{
+				continue;
+			}
+
+			int *fds = realloc(th->fds, sizeof(int) * (th->num + 1));
+			th->fds = fds ? fds : th->fds;
+			long *idv = realloc(th->ids, sizeof(long) * (th->num + 1));
+			th->ids = idv ? idv : th->ids;
+			if (fds == NULL || idv == NULL)
+			{
+				close(fd);
+				close(dir);
+				closedir(cpus);
+				return -1;
+			}
+
+			th->fds[th->num] = fd;
+			th->ids[th->num] = ids[k];
+			++th->num;
+		}
+		close(dir);
+	}
+
+	closedir(cpus);
+	return 0;
+}
+
+void free_throttle(struct throttle *th)
 {
-	return (celcius * 1.8) + 32;
+	for (size_t i = 0; i < th->num; ++i)
+	{
+		close(th->fds[i]);
+	}
+	free(th->fds);
+	free(th->ids);
+	*th = (struct throttle) { 0 };
 }
 
 /**
- * Goes through the list of chips and looks for the one with the given prefix.
- * Returns the specified chip if found, otherwise NULL.
-sensors_chip_name const *find_chip(const char *prefix)
+ * Reads all throttle counters, one pread() each, and updates the total 
+ * number of throttle events, as well as the increase since the last read.
+ */
+void read_throttle(struct throttle *th)
 {
-	sensors_chip_name const *cm = NULL; // matched chip
-	int c = 0;
+	unsigned long total = 0;
+	long count;
 
-	// Iterate over the chips
-	while(cm = sensors_get_detected_chips(NULL, &c))
+	for (size_t i = 0; i < th->num; ++i)
 	{
-		// Check if this is the chip the user is interested in
-		if (prefix && strstr(cm->prefix, prefix) != NULL)
+		if (read_long(th->fds[i], &count) == 0)
 		{
-			return cm;
+			total += count;
 		}
 	}
-	return NULL;
+
+	th->delta = th->read && total > th->total ? total - th->total : 0;
+	th->total = total;
+	th->read = 1;
 }
+
+/**
+ * Checks whether the throttle counters changed since they were last printed.
+ * If so, remembers them as printed and returns 1, otherwise returns 0.
  */
+int throttle_changed(struct throttle *th)
+{
+	if (th->total == th->total_prev && th->delta == th->delta_prev)
+	{
+		return 0;
+	}
+
+	th->total_prev = th->total;
+	th->delta_prev = th->delta;
+	return 1;
+}
 
 /**
- * Tries to read the actual temperature value from the specified feature
- * of the specified chip. Writes the temperature vlue to ret. Returns 0 on
- * success, -1 on error. 
-int get_temp_value(const sensors_chip_name *chip, const sensors_feature *feat, double *ret)
+ * Updates headroom and limit state of `t` with the reading `curr` of a 
+ * sensor with the given max and crit limits (NAN if it doesn't have them).
+ * The headroom is measured to the max limit, or crit if there is no max.
+ */
+void check_limits(struct temps *t, double curr, double max, double crit)
 {
-	// Loop over the subfeatures
-	sensors_subfeature const *sc; // current subfeature
-	int s = 0;
-	double val = 0.0;
+	double limit = isnan(max) ? crit : max;
+	if (!isnan(limit) && limit - curr < t->headroom)
+	{
+		t->headroom = limit - curr;
+	}
 
-	while(sc = sensors_get_all_subfeatures(chip, feat, &s))
+	if (!isnan(crit) && curr >= crit)
 	{
-		// Not the tempreature reading? Not interested!
-		if (sc->type != SENSORS_SUBFEATURE_TEMP_INPUT)
-		{
-			continue;
-		}
+		t->limit = LIMIT_CRIT;
+	}
+	else if (!isnan(max) && curr >= max && t->limit < LIMIT_MAX)
+	{
+		t->limit = LIMIT_MAX;
+	}
+}
 
-		// Early return if value can't be read
-		if ((sc->flags & SENSORS_MODE_R) == 0)
+/**
+ * Parses the name of an aggregation mode. Returns the mode, or -1 if the
+ * name isn't known.
+ */
+int parse_aggregation(const char *name)
+{
+	const char *names[] = { "avg", "max", "min", "median", "each" };
+	for (int a = 0; a < 5; ++a)
+	{
+		if (strcmp(name, names[a]) == 0)
 		{
-			return -1;
+			return a;
 		}
+	}
+	return -1;
+}
 
-		int rc = sensors_get_value(chip, sc->number, ret);
+/**
+ * Makes sure there's room for at least `size` readings in `t`.
+ * Returns 0 on success, -1 on error.
+ */
+int reserve_temps(struct temps *t, size_t size)
+{
+	if (size <= t->size)
+	{
+		return 0;
+	}
 
-		// Early return if value couldn't be read
-		if (rc != 0)
-		{
-			return -1;
-		}
+	double *vals   = realloc(t->vals,   sizeof(double) * size);
+	t->vals = vals ? vals : t->vals;
+	double *sorted = realloc(t->sorted, sizeof(double) * size);
+	t->sorted = sorted ? sorted : t->sorted;
+	double *prev   = realloc(t->prev,   sizeof(double) * size);
+	t->prev = prev ? prev : t->prev;
+	double *ema    = realloc(t->ema,    sizeof(double) * size);
+	t->ema = ema ? ema : t->ema;
 
-		return 0;
+	if (vals == NULL || sorted == NULL || prev == NULL || ema == NULL)
+	{
+		return -1;
 	}
+
+	for (size_t i = t->size; i < size; ++i)
+	{
+		t->ema[i] = NAN;
+	}
+
+	t->size = size;
+	return 0;
 }
- */
 
-/**
- * List all temperature features of the provided chip, including their readings.
- * Temperature readings will be formatted according to precision and unit.
-void list_features(sensors_chip_name const *cm, struct config *cfg)
+void free_temps(struct temps *t)
 {
-	// Iterate over the features
-	sensors_feature const *fc = NULL; // current feature
-	int f = 0;
+	free(t->vals);
+	free(t->sorted);
+	free(t->prev);
+	free(t->ema);
+	*t = (struct temps) { 0 };
+}
 
-	while (fc = sensors_get_features(cm, &f))
+/**
+ * Feeds the reading `val` of the i-th feature into its exponential moving
+ * average and returns the smoothed value. With an `alpha` of 1, there is no
+ * smoothing at all. Needs no memory besides the one average per feature.
+ */
+double smooth_temp(struct temps *t, size_t i, double val, double alpha)
+{
+	if (isnan(t->ema[i]))
 	{
-		// Not a temperature? Not interested!
-		if (fc->type != SENSORS_FEATURE_TEMP)
-		{
-			continue;
-		}
+		t->ema[i] = val;
+	}
+	else
+	{
+		t->ema[i] += alpha * (val - t->ema[i]);
+	}
+	return t->ema[i];
+}
 
-		// Get the feature's label
-		char *fl = sensors_get_label(cm, fc);
-		if (fl == NULL)
-		{
-			// Error getting the label
-			continue;
-		}
+int compare_temps(const void *a, const void *b)
+{
+	double da = *(const double *) a;
+	double db = *(const double *) b;
+	return (da > db) - (da < db);
+}
 
-		// Get the feature's value and print
-		double temp;
-		if (get_temp_value(cm, fc, &temp) == 0)
-		{
-			fprintf(stdout, " '-[F%d] %s (%.*f%s%s)\n", f, fl, 
-				cfg->precision, 
-				cfg->imperial ? to_fahrenheit(temp) : temp,
-				cfg->space && cfg->unit ? " " : "",
-				cfg->unit_str);
-		}
-		else
-		{
-			fprintf(stdout, " '-[F%d] %s (n/a)", f, fl); 
-		}
+/**
+ * Calculates average, maximum, minimum and median of the current readings.
+ */
+void aggregate_temps(struct temps *t)
+{
+	double sum = 0.0;
+	t->max = -DBL_MAX;
+	t->min =  DBL_MAX;
 
-		free(fl);
-		fl = NULL;
+	for (size_t i = 0; i < t->num; ++i)
+	{
+		sum += t->vals[i];
+		t->max = t->vals[i] > t->max ? t->vals[i] : t->max;
+		t->min = t->vals[i] < t->min ? t->vals[i] : t->min;
 	}
+	t->avg = t->num ? sum / t->num : 0.0;
+
+	// we don't want to mess up the feature order in vals, hence the copy
+	memcpy(t->sorted, t->vals, sizeof(double) * t->num);
+	qsort(t->sorted, t->num, sizeof(double), compare_temps);
+	t->median = t->num % 2 ? t->sorted[t->num / 2] :
+		(t->sorted[t->num / 2 - 1] + t->sorted[t->num / 2]) / 2.0;
 }
+
+/**
+ * Returns the aggregate selected via `-a`; not meaningful for AGGR_EACH.
  */
+double selected_temp(struct temps *t, int aggr)
+{
+	switch (aggr)
+	{
+		case AGGR_MAX:
+			return t->max;
+		case AGGR_MIN:
+			return t->min;
+		case AGGR_MEDIAN:
+			return t->median;
+		default:
+			return t->avg;
+	}
+}
 
 /**
- * Prints all detected chips and their features to stdout.
+ * Checks whether the readings changed enough since the last time they were 
+ * printed: rising by at least `threshold`, or falling by at least `threshold`
+ * plus `hysteresis`. This way, a value jittering around the printed one does 
+ * not cause output over and over again. In 'each' mode, every single reading 
+ * is considered, otherwise only the selected aggregate; a change in cooling 
+ * state always counts. If so, remembers them as printed and returns 1, 
+ * otherwise returns 0.
  */
-int list_chips_and_features(struct config *cfg)
+int temps_changed(struct temps *t, int aggr, double threshold, double hysteresis)
 {
-	DIR *hwmon = opendir(cfg->path);
-	
-	if (hwmon == NULL)
+	double curr = selected_temp(t, aggr);
+	double *vals = aggr == AGGR_EACH ? t->vals : &curr;
+	size_t num = aggr == AGGR_EACH ? t->num : 1;
+
+	int changed = num != t->prev_num || t->cooling != t->cooling_prev;
+	for (size_t i = 0; i < num && !changed; ++i)
 	{
-		return -1;
+		changed = vals[i] - t->prev[i] >= threshold || 
+			t->prev[i] - vals[i] >= threshold + hysteresis;
 	}
 
-	struct dirent *direntry = NULL;
-	size_t c = 0;
-	
-	while ((direntry = readdir(hwmon)))
+	if (changed)
 	{
-		// TODO free() and fclose()/close() everything
-		//      and make sure we also do it if we return -1
+		memcpy(t->prev, vals, sizeof(double) * num);
+		t->prev_num = num;
+		t->cooling_prev = t->cooling;
+	}
+	return changed;
+}
 
-		// Skipping everything that doesn't start with "hwmon"
-		// or whatever else is in the config's 'file' field 
-		if (strncmp(direntry->d_name, cfg->file, strlen(cfg->file)) != 0)
-		{
-			continue;
-		}
-	
-		size_t chip_path_len = strlen(cfg->path) + 1 + strlen(direntry->d_name) + 1;
-		char *chip_path = malloc(sizeof(char) * chip_path_len);
-		snprintf(chip_path, chip_path_len, "%s/%s", cfg->path, direntry->d_name);
-	
-		DIR *chip = opendir(chip_path);
-		if (chip == NULL)
-		{
-			free(chip_path);
-			return -1;
-		}
+/**
+ * Formats a temperature value according to precision and unit.
+ */
+void format_temp(char *buf, size_t len, double temp, struct config *cfg)
+{
+	snprintf(buf, len, "%.*f%s%s", cfg->precision, temp, 
+			cfg->space && cfg->unit ? " " : "", cfg->unit_str);
+}
 
-		size_t name_path_len = strlen(chip_path) + 1 + strlen("name") + 1;
-		char *name_path = malloc(sizeof(char) * name_path_len);
-		snprintf(name_path, name_path_len, "%s/%s", chip_path, "name");
-		free(chip_path);
-		
-		FILE *name_file = fopen(name_path, "r");
-		free(name_path);
-		if (name_file == NULL)
-		{
-			closedir(chip);
-			return -1;
-		}
+/**
+ * Formats all current readings, separated by a space.
+ */
+void format_each(char *buf, size_t len, struct temps *t, struct config *cfg)
+{
+	size_t pos = 0;
+	buf[0] = '\0';
 
-		// Using fscanf() vs fgets() or getline() helps to skip all the 
-		// potential whitespace at the end of a line in these files
-		char *chip_name = NULL; 
-		if (fscanf(name_file, "%ms", &chip_name) != 1)
+	for (size_t i = 0; i < t->num && pos + RESULT_SIZE + 1 < len; ++i)
+	{
+		if (i)
 		{
-			fclose(name_file);
-			free(chip_name);
-			closedir(chip);
-			return -1;
+			buf[pos++] = ' ';
 		}
+		format_temp(buf + pos, RESULT_SIZE, t->vals[i], cfg);
+		pos += strlen(buf + pos);
+	}
+}
 
-		// Finally print the chip name
-		fprintf(stdout, "[C%ld] %s (from %s)\n", c, chip_name, cfg->path);
-		++c;
-
-		fclose(name_file);
-		free(chip_name);
-
-		// TODO list features for this chip
+char *candy_format_cb(char c, void *context)
+{
+	struct context *ctx = (struct context *) context;
+	struct temps *t = ctx->temps;
 
-		
-		closedir(chip);
+	// no temperatures (only -S given, or no readings), nothing to print
+	if (t->num == 0 && strchr("taxnmhw", c))
+	{
+		return "-";
 	}
 
-	closedir(hwmon);
-	return 0;
+	switch (c)
+	{
+		case 't': // selected aggregate, or all readings
+			if (ctx->cfg->aggr == AGGR_EACH)
+			{
+				format_each(ctx->buffer, OUTPUT_SIZE, t, ctx->cfg);
+			}
+			else
+			{
+				format_temp(ctx->buffer, RESULT_SIZE, 
+						selected_temp(t, ctx->cfg->aggr), ctx->cfg);
+			}
+			return ctx->buffer;
+		case 'a': // average
+			format_temp(ctx->buffer, RESULT_SIZE, t->avg, ctx->cfg);
+			return ctx->buffer;
+		case 'x': // maximum
+			format_temp(ctx->buffer, RESULT_SIZE, t->max, ctx->cfg);
+			return ctx->buffer;
+		case 'n': // minimum
+			format_temp(ctx->buffer, RESULT_SIZE, t->min, ctx->cfg);
+			return ctx->buffer;
+		case 'm': // median
+			format_temp(ctx->buffer, RESULT_SIZE, t->median, ctx->cfg);
+			return ctx->buffer;
+		case 'c': // number of readings
+			snprintf(ctx->buffer, RESULT_SIZE, "%zu", t->num);
+			return ctx->buffer;
+		case 'd': // distance to the next trip point
+			if (t->trip_type == NULL)
+			{
+				return "-";
+			}
+			format_temp(ctx->buffer, RESULT_SIZE, t->trip_dist, ctx->cfg);
+			return ctx->buffer;
+		case 'T': // temperature of the next trip point
+			if (t->trip_type == NULL)
+			{
+				return "-";
+			}
+			format_temp(ctx->buffer, RESULT_SIZE, t->trip_temp, ctx->cfg);
+			return ctx->buffer;
+		case 'y': // type of the next trip point
+			return t->trip_type ? (char *) t->trip_type : "-";
+		case 'k': // current cooling state
+			snprintf(ctx->buffer, RESULT_SIZE, "%ld", t->cooling);
+			return ctx->buffer;
+		case 'K': // maximum cooling state
+			snprintf(ctx->buffer, RESULT_SIZE, "%ld", ctx->cooling_max);
+			return ctx->buffer;
+		case 'h': // headroom to the max (or crit) limit
+			if (t->headroom == DBL_MAX)
+			{
+				return "-";
+			}
+			format_temp(ctx->buffer, RESULT_SIZE, t->headroom, ctx->cfg);
+			return ctx->buffer;
+		case 'w': // highest limit reached
+			return t->limit == LIMIT_CRIT ? "crit" : (t->limit == LIMIT_MAX ? "max" : "ok");
+		case 'r': // throttle events since the last check
+			if (ctx->throttle->num == 0)
+			{
+				return "-";
+			}
+			snprintf(ctx->buffer, RESULT_SIZE, "%lu", ctx->throttle->delta);
+			return ctx->buffer;
+		case 'R': // throttle events since boot
+			if (ctx->throttle->num == 0)
+			{
+				return "-";
+			}
+			snprintf(ctx->buffer, RESULT_SIZE, "%lu", ctx->throttle->total);
+			return ctx->buffer;
+		case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+			if ((size_t) (c - '1') >= ctx->num_sensors)
+			{
+				return NULL;
+			}
+			struct sensor *sensor = &ctx->sensors[c - '1'];
+			if (!sensor->ok)
+			{
+				return "-";
+			}
+			format_sensor(ctx->buffer, RESULT_SIZE, sensor->class, sensor->val, ctx->cfg);
+			return ctx->buffer;
+		default:
+			return NULL;
+	}
 }
 
-/*
-double determine_temp(const char *chip, const char *feat, double *t, size_t *n)
+/**
+ * Prints the current readings to stdout, according to the format string.
+ */
+void print_temps(struct config *cfg, struct temps *t, struct chip *chip, struct sensor *sensors, size_t num_sensors, struct throttle *th)
 {
-	// Iterate over the features
-	sensors_feature const *fc = NULL; // current feature
-	int f = 0;
-
-	*t = 0.0;
-	*n = 0;
-
-	double curr = 0.0;
+	struct context ctx = { .cfg = cfg, .temps = t, .cooling_max = chip->cdevs_max,
+		.sensors = sensors, .num_sensors = num_sensors, .throttle = th };
+	char output[OUTPUT_SIZE];
+	candy_format(cfg->format, output, OUTPUT_SIZE, candy_format_cb, &ctx);
+	fprintf(stdout, "%s\n", output);
+}
 
-	while (fc = sensors_get_features(cm, &f))
+/**
+ * Finds the trip point of the feature (thermal zone) that is closest ahead of
+ * its current temperature `curr`, if it's closer than `*dist`. If so, updates 
+ * `dist`, `temp` and `next`.
+ */
+void find_next_trip(struct feature *feat, double curr, double *dist, double *temp, struct trip **next)
+{
+	double trip;
+	for (size_t i = 0; i < feat->num_trips; ++i)
 	{
-		// Not a temperature? Not interested!
-		if (fc->type != SENSORS_FEATURE_TEMP)
+		if (read_temp(feat->trips[i].fd, &trip) == 0 && trip > curr && trip - curr < *dist)
 		{
-			continue;
+			*dist = trip - curr;
+			*temp = trip;
+			*next = &feat->trips[i];
 		}
+	}
+}
 
-		// Get the feature's label
-		char *fl = sensors_get_label(cm, fc);
-		if (fl == NULL)
-		{
-			// Error getting the label
-			continue;
-		}
+/**
+ * Reads the current temperature of all features of the chip into `t`, 
+ * converting them to Fahrenheit if requested, and checks them against their 
+ * limits. For thermal zones, also reads the trip points and cooling devices,
+ * if the format string asks for them.
+ * Returns the number of readings obtained.
+ */
+size_t determine_temps(struct chip *chip, struct config *cfg, struct temps *t)
+{
+	double curr = 0.0;
+	double dist = DBL_MAX;
+	double trip = 0.0;
+	struct trip *next = NULL;
+	t->num = 0;
+	t->headroom = DBL_MAX;
+	t->limit = LIMIT_OK;
 
-		// Check if this is a feature the user is interested in
-		if (feat && strstr(fl, feat) != NULL)
+	for (size_t f = 0; f < chip->num_feats && t->num < t->size; ++f)
+	{
+		if (read_temp(chip->feats[f].fd, &curr) == 0)
 		{
-			// If so, we get the temperature and add it
-			curr = 0.0;
-			if (get_temp_value(cm, fc, &curr) != 0)
+			t->vals[t->num++] = smooth_temp(t, f, 
+					cfg->imperial ? to_fahrenheit(curr) : curr, cfg->alpha);
+			check_limits(t, curr, chip->feats[f].max, chip->feats[f].crit);
+
+			if (cfg->trips)
 			{
-				continue;
+				find_next_trip(&chip->feats[f], curr, &dist, &trip, &next);
 			}
-
-			*t += curr;
-			++(*n);
 		}
-
-		free(fl);
-		fl = NULL;
 	}
 
-	return *t / *n;
-}
-*/
+	// trip points are in Celsius as well, and so is the distance
+	t->trip_type = next ? next->type : NULL;
+	t->trip_dist = cfg->imperial ? dist * 1.8 : dist;
+	t->trip_temp = cfg->imperial ? to_fahrenheit(trip) : trip;
 
+	// limits are in Celsius as well, and so is the headroom
+	if (cfg->imperial && t->headroom != DBL_MAX)
+	{
+		t->headroom *= 1.8;
+	}
 
-/**
- * Prints the provided temperature value to stdout.
- */
-void print_temp(double temp, int precision, const char *unit, int space)
-{
-	fprintf(stdout, "%.*f%s%s\n", precision, temp, 
-			space && strlen(unit) ? " " : "", unit);
+	long state;
+	t->cooling = 0;
+	for (size_t c = 0; cfg->cooling && c < chip->num_cdevs; ++c)
+	{
+		if (read_long(chip->cdevs[c].fd, &state) == 0)
+		{
+			t->cooling += state;
+		}
+	}
+
+	if (t->num)
+	{
+		aggregate_temps(t);
+	}
+	return t->num;
 }
 
 /**
@@ -288,17 +1805,45 @@ void help(char *invocation)
 {
 	fprintf(stderr, "Usage:\n");
      	fprintf(stderr, "\t%s [OPTIONS...] -c CHIP -f FEATURE\n", invocation);
+     	fprintf(stderr, "\t%s [OPTIONS...] -z ZONE\n", invocation);
+     	fprintf(stderr, "\t%s [OPTIONS...] -S CHIP:ATTR [-S CHIP:ATTR...]\n", invocation);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t-a Aggregation of all matching features: avg, max, min, median or each; default is avg.\n");
 	fprintf(stderr, "\t-e Use Fahrenheit instead of Celcius.\n");
+	fprintf(stderr, "\t-H Additional drop in value required in order to print again; default is 0.\n");
 	fprintf(stderr, "\t-h Print this help text and exit.\n");
 	fprintf(stderr, "\t-i Seconds between checking for a change in value; default is 1.\n");
 	fprintf(stderr, "\t-l List all chips and features, then exit.\n");
 	fprintf(stderr, "\t-m Keep running and print when there is a notable change in value.\n");
+	fprintf(stderr, "\t-n Don't use (or update) the discovery cache.\n");
+	fprintf(stderr, "\t-o Format string, see below; default is '%%t'.\n");
 	fprintf(stderr, "\t-p Number of decimal digits in the output; default is 0.\n");
+	fprintf(stderr, "\t-r Path sysfs is mounted at; default is '/sys'.\n");
+	fprintf(stderr, "\t-S Read the sensor attribute ATTR (like fan1_input) of chip CHIP; up to 9 times.\n");
 	fprintf(stderr, "\t-s Print a space between value and unit.\n");
 	fprintf(stderr, "\t-t Required change in value in order to print again; default is 1.\n");
 	fprintf(stderr, "\t-u Include the temperature unit in the output.\n");
+	fprintf(stderr, "\t-w Smooth readings with a moving average over about this many checks.\n");
+	fprintf(stderr, "\t-z Use the thermal zones whose type contains ZONE, instead of a chip.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Format specifiers:\n");
+	fprintf(stderr, "\t%%t Temperature, aggregated according to -a\n");
+	fprintf(stderr, "\t%%a Average temperature\n");
+	fprintf(stderr, "\t%%x Maximum temperature\n");
+	fprintf(stderr, "\t%%n Minimum temperature\n");
+	fprintf(stderr, "\t%%m Median temperature\n");
+	fprintf(stderr, "\t%%c Number of readings\n");
+	fprintf(stderr, "\t%%d Distance to the closest trip point ahead (thermal zones)\n");
+	fprintf(stderr, "\t%%T Temperature of that trip point (thermal zones)\n");
+	fprintf(stderr, "\t%%y Type of that trip point (thermal zones)\n");
+	fprintf(stderr, "\t%%k Current state of all cooling devices (thermal zones)\n");
+	fprintf(stderr, "\t%%K Maximum state of all cooling devices (thermal zones)\n");
+	fprintf(stderr, "\t%%h Headroom to the closest max (or crit) limit\n");
+	fprintf(stderr, "\t%%w Highest limit reached: ok, max or crit\n");
+	fprintf(stderr, "\t%%r CPU thermal throttle events since the last check\n");
+	fprintf(stderr, "\t%%R CPU thermal throttle events since boot\n");
+	fprintf(stderr, "\t%%1 .. %%9 Reading of the 1st .. 9th sensor given via -S\n");
 }
 
 int main(int argc, char **argv)
@@ -309,10 +1854,13 @@ int main(int argc, char **argv)
 	// Get arguments, if any
 	opterr = 0;
 	int o;
-	while ((o = getopt(argc, argv, "c:ef:hi:lmp:st:u")) != -1)
+	while ((o = getopt(argc, argv, "a:c:ef:H:hi:lmno:p:r:S:st:uw:z:")) != -1)
 	{
 		switch (o)
 		{
+			case 'a':
+				cfg.aggr = parse_aggregation(optarg);
+				break;
 			case 'c':
 				cfg.chip = optarg;
 				break;
@@ -322,6 +1870,9 @@ int main(int argc, char **argv)
 			case 'f':
 				cfg.feat = optarg;
 				break;
+			case 'H':
+				cfg.hysteresis = atof(optarg);
+				break;
 			case 'h':
 				help(argv[0]);
 				return EXIT_SUCCESS;
@@ -334,9 +1885,24 @@ int main(int argc, char **argv)
 			case 'm':
 				cfg.monitor = 1;
 				break;
+			case 'n':
+				cfg.nocache = 1;
+				break;
+			case 'o':
+				cfg.format = optarg;
+				break;
 			case 'p':
 				cfg.precision = atoi(optarg);
 				break;
+			case 'r':
+				cfg.root = optarg;
+				break;
+			case 'S':
+				if (cfg.num_sels < MAX_SENSORS)
+				{
+					cfg.sels[cfg.num_sels++] = optarg;
+				}
+				break;
 			case 's':
 				cfg.space = 1;
 				break;
@@ -346,13 +1912,56 @@ int main(int argc, char **argv)
 			case 'u':
 				cfg.unit = 1;
 				break;
+			case 'w':
+				// same weight as a simple moving average over that window
+				cfg.alpha = 2.0 / (atoi(optarg) + 1);
+				break;
+			case 'z':
+				cfg.zone = optarg;
+				break;
 		}
 	}
 	
 	// Prepare strings we'll need multiple times 
 	cfg.unit_str = cfg.unit ? (cfg.imperial ? UNIT_IMPERIAL : UNIT_METRIC) : "";
-	cfg.path = DEFAULT_PATH; // TODO
-	cfg.file = DEFAULT_FILE; // TODO
+
+	// Without a format string, sensors are printed one after the other
+	char sensors_format[MAX_SENSORS * 3] = { 0 };
+	size_t len = 0;
+	for (size_t s = 0; s < cfg.num_sels; ++s)
+	{
+		len += snprintf(sensors_format + len, sizeof(sensors_format) - len, 
+				"%s%%%zu", s ? " " : "", s + 1);
+	}
+
+	// All sysfs paths are relative to the root, which can be a fake tree
+	cfg.root = cfg.root ? cfg.root : DEFAULT_ROOT;
+	char path[PATH_MAX];
+	char thermal[PATH_MAX];
+	char cpus[PATH_MAX];
+	snprintf(path, PATH_MAX, "%s%s", cfg.root, DEFAULT_PATH);
+	snprintf(thermal, PATH_MAX, "%s%s", cfg.root, DEFAULT_THERMAL);
+	snprintf(cpus, PATH_MAX, "%s%s", cfg.root, DEFAULT_CPU_PATH);
+
+	cfg.path = path;
+	cfg.file = DEFAULT_FILE;
+	cfg.thermal = thermal;
+	cfg.zone_file = DEFAULT_ZONE_FILE;
+	cfg.cpus = cpus;
+	cfg.format = cfg.format ? cfg.format : (cfg.num_sels ? sensors_format : DEFAULT_FORMAT);
+
+	// Only read limits, trip points and cooling devices if we're going to print them
+	cfg.limits = strstr(cfg.format, "%h") || strstr(cfg.format, "%w");
+	cfg.trips = strstr(cfg.format, "%d") || strstr(cfg.format, "%T") || strstr(cfg.format, "%y");
+	cfg.cooling = strstr(cfg.format, "%k") != NULL;
+	cfg.throttle = strstr(cfg.format, "%r") || strstr(cfg.format, "%R");
+
+	// Unknown aggregation mode? Print help and exit
+	if (cfg.aggr == -1)
+	{
+		help(argv[0]);
+		return EXIT_FAILURE;
+	}
 
 	// List chips and exit (if that's what we're supposed to do)
 	if (cfg.list)
@@ -361,22 +1970,60 @@ int main(int argc, char **argv)
 		return EXIT_SUCCESS;
 	}
 
-	// Chip and/or feature not given? Print help and exit
-	if (cfg.chip == NULL || cfg.feat == NULL)
+	// Neither chip and feature nor zone nor sensors given? Print help and exit
+	int temps_given = cfg.zone || (cfg.chip && cfg.feat);
+	if (!temps_given && cfg.num_sels == 0)
 	{
 		help(argv[0]);
 		return EXIT_SUCCESS;
 	}
-	
-	// Find the chip that matches the provided chip name
-	//const char *chip = find_chip(cfg.chip);
-	const char *chip = NULL; // TODO
 
-	// Abort if we didn't find any matching chips
-	if (chip == NULL)
+	// Parse the sensor selectors and find all of their chips in one go
+	struct sensor sensors[MAX_SENSORS];
+	size_t num_sensors = 0;
+	for (; num_sensors < cfg.num_sels; ++num_sensors)
+	{
+		if (parse_sensor(cfg.sels[num_sensors], &sensors[num_sensors]) == -1)
+		{
+			fprintf(stderr, "Unsupported sensor: %s\n", cfg.sels[num_sensors]);
+			free_sensors(sensors, num_sensors);
+			return EXIT_FAILURE;
+		}
+	}
+	if (num_sensors && find_sensors(&cfg, sensors, num_sensors) == -1)
 	{
+		free_sensors(sensors, num_sensors);
 		return EXIT_FAILURE;
 	}
+	
+	struct chip chip = { 0 };
+	if (cfg.zone)
+	{
+		// Find all thermal zones of the given type (only once)
+		if (find_zones(&cfg, cfg.zone, &chip) == -1 || chip.num_feats == 0)
+		{
+			free_sensors(sensors, num_sensors);
+			free_chip(&chip);
+			return EXIT_FAILURE;
+		}
+	}
+	else if (temps_given && (cfg.nocache || load_cache(&cfg, &chip) == -1))
+	{
+		// Find the chip that matches the provided chip name, as well as its 
+		// features that match the provided feature name (only once), either
+		// from the discovery cache or by scanning all hwmon entries
+		if (find_chip(&cfg, cfg.chip, cfg.feat, &chip) == -1 || chip.num_feats == 0)
+		{
+			free_sensors(sensors, num_sensors);
+			free_chip(&chip);
+			return EXIT_FAILURE;
+		}
+
+		if (!cfg.nocache)
+		{
+			save_cache(&cfg, &chip);
+		}
+	}
 
 	// If no threshold given, determine it based on the precision
 	if (cfg.threshold == -1)
@@ -384,6 +2031,12 @@ int main(int argc, char **argv)
 		cfg.threshold = DEFAULT_THRESHOLD / pow(10.0, (double) cfg.precision);
 	}
 
+	// No (or no useful) smoothing window given, don't smooth
+	if (cfg.alpha <= 0.0 || cfg.alpha > 1.0)
+	{
+		cfg.alpha = 1.0;
+	}
+
 	// If no interval given, use the default
 	if (cfg.interval == 0)
 	{
@@ -401,41 +2054,54 @@ int main(int argc, char **argv)
 	setlinebuf(stdout);
 
 	// Loop vars
-	size_t temp_num = 0;
-	double temp_avg_prev  = -DBL_MAX;
-	double temp_avg_curr  =  0.0;
-	double temp_avg_delta =  0.0;
+	struct temps temps = { 0 };
+	if (reserve_temps(&temps, chip.num_feats ? chip.num_feats : 1) == -1)
+	{
+		free_temps(&temps);
+		free_sensors(sensors, num_sensors);
+		free_chip(&chip);
+		return EXIT_FAILURE;
+	}
+
+	// Throttle counters, if requested (missing ones just print as "-")
+	struct throttle throttle = { 0 };
+	if (cfg.throttle)
+	{
+		load_throttle(cfg.cpus, &throttle);
+	}
 
+	int changed;
 	do
 	{
-		// Get the current temperature (average of all found values)
-		//temp_avg_curr = determine_temp(cfg.chip, cfg.feat, &temp_sum, &temp_num);
-		temp_avg_curr = 0; // TODO
-		
-		// We didn't manage to find a temp value
-		if (temp_num <= 0)
+		// Get the current temperatures (all matching features)
+		if (temps_given && determine_temps(&chip, &cfg, &temps) == 0)
 		{
+			// We didn't manage to find a temp value
 			// k thx bye :(
+			free_throttle(&throttle);
+			free_temps(&temps);
+			free_sensors(sensors, num_sensors);
+			free_chip(&chip);
 			return EXIT_FAILURE;
 		}
 
-		// Convert to Fahrenheit, if the user asked us to
-		if (cfg.imperial)
-		{
-			temp_avg_curr = to_fahrenheit(temp_avg_curr);
-		}
-
-		// Figure out the difference to the previously printed value
-		temp_avg_delta = fabs(temp_avg_curr - temp_avg_prev);
+		// Get the current readings of all other sensors
+		read_sensors(sensors, num_sensors, &cfg);
 
 		// Check if the difference is significant enough
-		if (temp_avg_delta >= cfg.threshold)
+		changed  = temps_given && temps_changed(&temps, cfg.aggr, cfg.threshold, cfg.hysteresis);
+		changed |= sensors_changed(sensors, num_sensors, cfg.threshold);
+
+		// Get the current throttle counters
+		if (cfg.throttle)
 		{
-			// Print (and possibly convert to Fahrenheit first) 
-			print_temp(temp_avg_curr, cfg.precision, cfg.unit_str, cfg.space);
+			read_throttle(&throttle);
+			changed |= throttle_changed(&throttle);
+		}
 
-			// Update values
-			temp_avg_prev = temp_avg_curr;
+		if (changed)
+		{
+			print_temps(&cfg, &temps, &chip, sensors, num_sensors, &throttle);
 		}
 
 		// Sleep, maybe (if interval > 0)
@@ -443,5 +2109,9 @@ int main(int argc, char **argv)
 	}
 	while (cfg.monitor);
 
+	free_throttle(&throttle);
+	free_temps(&temps);
+	free_sensors(sensors, num_sensors);
+	free_chip(&chip);
 	return EXIT_SUCCESS;
 }
@@ -1,17 +1,27 @@
 #include <stdio.h>            // fprintf
 #include <stdlib.h>           // NULL, EXIT_*
-#include <unistd.h>           // getopt() et al.
+#include <unistd.h>           // getopt() et al., pread(), close()
 #include <string.h>           // strstr()
-#include <math.h>             // pow(), fabs()
+#include <math.h>             // pow(), fabs(), isnan()
 #include <float.h>            // DBL_MAX
+#include <fcntl.h>            // openat()
+#include <dirent.h>           // opendir(), readdir()
 #include <sensors/sensors.h>
+#include "candies.h"
 
 #define UNIT_METRIC   "°C" 
 #define UNIT_IMPERIAL "°F"
 
 #define DEFAULT_INTERVAL  1
 #define DEFAULT_THRESHOLD 1
+#define DEFAULT_FORMAT    "%t"
+#define DEFAULT_CPU_PATH  "/sys/devices/system/cpu"
 
+#define RESULT_SIZE  16
+#define OUTPUT_SIZE  1024
+#define VALUE_BUFLEN 16
+
+#define MAX_SELECTORS 9
 
 struct config 
 {
@@ -20,12 +30,88 @@ struct config
 	int unit : 1;           // also print the °C unit
 	int space : 1;          // space between val and unit
 	int imperial: 1;        // use fahrenheit (imperial)
+	int throttle : 1;       // read throttle counters (format uses them)
 	int precision;          // decimal places in output
+	int aggr;               // how to combine multiple readings
 	int interval;           // seconds between temp checks
-	double threshold;       // (not yet in use)
+	double threshold;       // required change in value in order to print
+	double hysteresis;      // additional drop required in order to print
+	double alpha;           // smoothing factor of the moving average
 	char *unit_str;
-	char *chip;	        // chip prefix to look for
-	char *feat;	        // feature label to look for
+	char *format;           // output format string
+	char *cpus;             // path with the CPU entries
+	char *chips[MAX_SELECTORS]; // chip prefixes to look for
+	char *feats[MAX_SELECTORS]; // feature labels to look for
+	size_t num_chips;
+	size_t num_feats;
+};
+
+struct input
+{
+	int number;             // number of the temperature input subfeature
+	double max;             // max limit, NAN if none
+	double crit;            // crit limit, NAN if none
+};
+
+struct chip
+{
+	sensors_chip_name const *name; // the matched chip
+	struct input *inputs;   // the matching temperature inputs
+	size_t num_inputs;
+};
+
+enum limit
+{
+	LIMIT_OK,               // below all limits
+	LIMIT_MAX,              // at or above the max limit
+	LIMIT_CRIT              // at or above the crit limit
+};
+
+enum aggregation
+{
+	AGGR_AVG,               // average of all readings
+	AGGR_MAX,               // highest reading
+	AGGR_MIN,               // lowest reading
+	AGGR_MEDIAN,            // median of all readings
+	AGGR_EACH               // all readings, one after the other
+};
+
+struct temps
+{
+	double *vals;           // current readings, in feature order
+	double *sorted;         // scratch space for the median
+	double *prev;           // readings (or aggregate) last printed
+	double *ema;            // moving average per feature, NAN until first read
+	size_t num;             // number of current readings
+	size_t prev_num;        // number of values in prev
+	size_t size;            // capacity of the arrays above
+	double avg;
+	double max;
+	double min;
+	double median;
+	double headroom;        // smallest distance to a max (or crit) limit
+	int limit;              // highest limit reached, see enum limit
+};
+
+struct throttle
+{
+	int *fds;               // held-open throttle counters
+	long *ids;              // core/package each counter belongs to
+	size_t num;
+	int read : 1;           // have the counters been read before?
+	unsigned long total;    // sum of all counters
+	unsigned long delta;    // increase since the previous check
+	unsigned long total_prev; // total last printed
+	unsigned long delta_prev; // delta last printed
+};
+
+struct context
+{
+	struct config *cfg;
+	struct temps *temps;    // one per selector
+	size_t num_temps;
+	struct throttle *throttle;
+	char buffer[OUTPUT_SIZE];
 };
 
 double to_fahrenheit(double celcius)
@@ -33,6 +119,49 @@ double to_fahrenheit(double celcius)
 	return (celcius * 1.8) + 32;
 }
 
+/**
+ * Reads the first line of a small (sysfs) file, relative to the directory
+ * `dir`, into `buf`, without the trailing newline. Returns 0 on success, 
+ * -1 on error.
+ */
+int read_line(int dir, const char *file, char *buf, size_t len)
+{
+	int fd = openat(dir, file, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		return -1;
+	}
+
+	ssize_t n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+	{
+		return -1;
+	}
+
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/**
+ * Reads a number from the given (held-open) sysfs file. 
+ * Returns 0 on success, -1 on error.
+ */
+int read_long(int fd, long *val)
+{
+	char buf[VALUE_BUFLEN];
+	ssize_t n = pread(fd, buf, VALUE_BUFLEN - 1, 0);
+	if (n <= 0)
+	{
+		return -1;
+	}
+
+	buf[n] = '\0';
+	*val = strtol(buf, NULL, 10);
+	return 0;
+}
+
 /**
  * Goes through the list of chips and looks for the one with the given prefix.
  * Returns the specified chip if found, otherwise NULL.
@@ -155,16 +284,466 @@ void list_chips_and_features(struct config *cfg)
 	}
 }
 
-double determine_temp(sensors_chip_name const *cm, const char *feat, double *t, size_t *n)
+/**
+ * Opens the thermal throttle counters of all CPUs. Logical CPUs that share a
+ * core report the same core counter, and all CPUs of a package report the 
+ * same package counter, so each of those is only opened once. Returns 0 on
+ * success, -1 on error.
+ */
+int load_throttle(const char *path, struct throttle *th)
+{
+	DIR *cpus = opendir(path);
+	if (cpus == NULL)
+	{
+		return -1;
+	}
+
+	const char *files[] = {
+		"thermal_throttle/core_throttle_count",
+		"thermal_throttle/package_throttle_count"
+	};
+
+	struct dirent *entry = NULL;
+	char line[VALUE_BUFLEN];
+	int cpu;
+	int len;
+
+	while ((entry = readdir(cpus)))
+	{
+		// exactly "cpu<N>", not "cpufreq" or "cpuidle"
+		len = 0;
+		if (sscanf(entry->d_name, "cpu%d%n", &cpu, &len) != 1 || entry->d_name[len] != '\0')
+		{
+			continue;
+		}
+
+		int dir = openat(dirfd(cpus), entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dir == -1)
+		{
+			continue;
+		}
+
+		long package = read_line(dir, "topology/physical_package_id", line, VALUE_BUFLEN) == 0 ?
+			strtol(line, NULL, 10) : 0;
+		long core = read_line(dir, "topology/core_id", line, VALUE_BUFLEN) == 0 ?
+			strtol(line, NULL, 10) : cpu;
+
+		// the package counter is tracked as core -1 of its package
+		long ids[] = { (package << 21) | (core + 1), package << 21 };
+
+		for (size_t k = 0; k < 2; ++k)
+		{
+			int known = 0;
+			for (size_t i = 0; i < th->num && !known; ++i)
+			{
+				known = th->ids[i] == ids[k];
+			}
+			if (known)
+			{
+				continue;
+			}
+
+			int fd = openat(dir, files[k], O_RDONLY | O_CLOEXEC);
+			if (fd == -1)
+			{
+				continue;
+			}
+
+			int *fds = realloc(th->fds, sizeof(int) * (th->num + 1));
+			th->fds = fds ? fds : th->fds;
+			long *idv = realloc(th->ids, sizeof(long) * (th->num + 1));
+			th->ids = idv ? idv : th->ids;
+			if (fds == NULL || idv == NULL)
+			{
+				close(fd);
+				close(dir);
+				closedir(cpus);
+				return -1;
+			}
+
+			th->fds[th->num] = fd;
+			th->ids[th->num] = ids[k];
+			++th->num;
+		}
+		close(dir);
+	}
+
+	closedir(cpus);
+	return 0;
+}
+
+void free_throttle(struct throttle *th)
+{
+	for (size_t i = 0; i < th->num; ++i)
+	{
+		close(th->fds[i]);
+	}
+	free(th->fds);
+	free(th->ids);
+	*th = (struct throttle) { 0 };
+}
+
+/**
+ * Reads all throttle counters, one pread() each, and updates the total 
+ * number of throttle events, as well as the increase since the last read.
+ */
+void read_throttle(struct throttle *th)
+{
+	unsigned long total = 0;
+	long count;
+
+	for (size_t i = 0; i < th->num; ++i)
+	{
+		if (read_long(th->fds[i], &count) == 0)
+		{
+			total += count;
+		}
+	}
+
+	th->delta = th->read && total > th->total ? total - th->total : 0;
+	th->total = total;
+	th->read = 1;
+}
+
+/**
+ * Checks whether the throttle counters changed since they were last printed.
+ * If so, remembers them as printed and returns 1, otherwise returns 0.
+ */
+int throttle_changed(struct throttle *th)
+{
+	if (th->total == th->total_prev && th->delta == th->delta_prev)
+	{
+		return 0;
+	}
+
+	th->total_prev = th->total;
+	th->delta_prev = th->delta;
+	return 1;
+}
+
+/**
+ * Updates headroom and limit state of `t` with the reading `curr` of a 
+ * sensor with the given max and crit limits (NAN if it doesn't have them).
+ * The headroom is measured to the max limit, or crit if there is no max.
+ */
+void check_limits(struct temps *t, double curr, double max, double crit)
+{
+	double limit = isnan(max) ? crit : max;
+	if (!isnan(limit) && limit - curr < t->headroom)
+	{
+		t->headroom = limit - curr;
+	}
+
+	if (!isnan(crit) && curr >= crit)
+	{
+		t->limit = LIMIT_CRIT;
+	}
+	else if (!isnan(max) && curr >= max && t->limit < LIMIT_MAX)
+	{
+		t->limit = LIMIT_MAX;
+	}
+}
+
+/**
+ * Parses the name of an aggregation mode. Returns the mode, or -1 if the
+ * name isn't known.
+ */
+int parse_aggregation(const char *name)
+{
+	const char *names[] = { "avg", "max", "min", "median", "each" };
+	for (int a = 0; a < 5; ++a)
+	{
+		if (strcmp(name, names[a]) == 0)
+		{
+			return a;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Makes sure there's room for at least `size` readings in `t`.
+ * Returns 0 on success, -1 on error.
+ */
+int reserve_temps(struct temps *t, size_t size)
+{
+	if (size <= t->size)
+	{
+		return 0;
+	}
+
+	double *vals   = realloc(t->vals,   sizeof(double) * size);
+	t->vals = vals ? vals : t->vals;
+	double *sorted = realloc(t->sorted, sizeof(double) * size);
+	t->sorted = sorted ? sorted : t->sorted;
+	double *prev   = realloc(t->prev,   sizeof(double) * size);
+	t->prev = prev ? prev : t->prev;
+	double *ema    = realloc(t->ema,    sizeof(double) * size);
+	t->ema = ema ? ema : t->ema;
+
+	if (vals == NULL || sorted == NULL || prev == NULL || ema == NULL)
+	{
+		return -1;
+	}
+
+	for (size_t i = t->size; i < size; ++i)
+	{
+		t->ema[i] = NAN;
+	}
+
+	t->size = size;
+	return 0;
+}
+
+void free_temps(struct temps *t)
+{
+	free(t->vals);
+	free(t->sorted);
+	free(t->prev);
+	free(t->ema);
+	*t = (struct temps) { 0 };
+}
+
+/**
+ * Feeds the reading `val` of the i-th feature into its exponential moving
+ * average and returns the smoothed value. With an `alpha` of 1, there is no
+ * smoothing at all. Needs no memory besides the one average per feature.
+ */
+double smooth_temp(struct temps *t, size_t i, double val, double alpha)
+{
+	if (isnan(t->ema[i]))
+	{
+		t->ema[i] = val;
+	}
+	else
+	{
+		t->ema[i] += alpha * (val - t->ema[i]);
+	}
+	return t->ema[i];
+}
+
+int compare_temps(const void *a, const void *b)
+{
+	double da = *(const double *) a;
+	double db = *(const double *) b;
+	return (da > db) - (da < db);
+}
+
+/**
+ * Calculates average, maximum, minimum and median of the current readings.
+ */
+void aggregate_temps(struct temps *t)
+{
+	double sum = 0.0;
+	t->max = -DBL_MAX;
+	t->min =  DBL_MAX;
+
+	for (size_t i = 0; i < t->num; ++i)
+	{
+		sum += t->vals[i];
+		t->max = t->vals[i] > t->max ? t->vals[i] : t->max;
+		t->min = t->vals[i] < t->min ? t->vals[i] : t->min;
+	}
+	t->avg = t->num ? sum / t->num : 0.0;
+
+	// we don't want to mess up the feature order in vals, hence the copy
+	memcpy(t->sorted, t->vals, sizeof(double) * t->num);
+	qsort(t->sorted, t->num, sizeof(double), compare_temps);
+	t->median = t->num % 2 ? t->sorted[t->num / 2] :
+		(t->sorted[t->num / 2 - 1] + t->sorted[t->num / 2]) / 2.0;
+}
+
+/**
+ * Returns the aggregate selected via `-a`; not meaningful for AGGR_EACH.
+ */
+double selected_temp(struct temps *t, int aggr)
+{
+	switch (aggr)
+	{
+		case AGGR_MAX:
+			return t->max;
+		case AGGR_MIN:
+			return t->min;
+		case AGGR_MEDIAN:
+			return t->median;
+		default:
+			return t->avg;
+	}
+}
+
+/**
+ * Checks whether the readings changed enough since the last time they were 
+ * printed: rising by at least `threshold`, or falling by at least `threshold`
+ * plus `hysteresis`. This way, a value jittering around the printed one does 
+ * not cause output over and over again. In 'each' mode, every single reading 
+ * is considered, otherwise only the selected aggregate. If so, remembers them 
+ * as printed and returns 1, otherwise returns 0.
+ */
+int temps_changed(struct temps *t, int aggr, double threshold, double hysteresis)
+{
+	double curr = selected_temp(t, aggr);
+	double *vals = aggr == AGGR_EACH ? t->vals : &curr;
+	size_t num = aggr == AGGR_EACH ? t->num : 1;
+
+	int changed = num != t->prev_num;
+	for (size_t i = 0; i < num && !changed; ++i)
+	{
+		changed = vals[i] - t->prev[i] >= threshold || 
+			t->prev[i] - vals[i] >= threshold + hysteresis;
+	}
+
+	if (changed)
+	{
+		memcpy(t->prev, vals, sizeof(double) * num);
+		t->prev_num = num;
+	}
+	return changed;
+}
+
+/**
+ * Formats a temperature value according to precision and unit.
+ */
+void format_temp(char *buf, size_t len, double temp, struct config *cfg)
+{
+	snprintf(buf, len, "%.*f%s%s", cfg->precision, temp, 
+			cfg->space && cfg->unit ? " " : "", cfg->unit_str);
+}
+
+/**
+ * Formats all current readings, separated by a space.
+ */
+void format_each(char *buf, size_t len, struct temps *t, struct config *cfg)
+{
+	size_t pos = 0;
+	buf[0] = '\0';
+
+	for (size_t i = 0; i < t->num && pos + RESULT_SIZE + 1 < len; ++i)
+	{
+		if (i)
+		{
+			buf[pos++] = ' ';
+		}
+		format_temp(buf + pos, RESULT_SIZE, t->vals[i], cfg);
+		pos += strlen(buf + pos);
+	}
+}
+
+/**
+ * Formats the selected aggregate, or all readings in 'each' mode.
+ */
+void format_selected(char *buf, struct temps *t, struct config *cfg)
+{
+	if (cfg->aggr == AGGR_EACH)
+	{
+		format_each(buf, OUTPUT_SIZE, t, cfg);
+	}
+	else
+	{
+		format_temp(buf, RESULT_SIZE, selected_temp(t, cfg->aggr), cfg);
+	}
+}
+
+char *candy_format_cb(char c, void *context)
+{
+	struct context *ctx = (struct context *) context;
+	struct temps *t = ctx->temps; // the first selector
+
+	switch (c)
+	{
+		case 't': // selected aggregate, or all readings
+			format_selected(ctx->buffer, t, ctx->cfg);
+			return ctx->buffer;
+		case 'a': // average
+			format_temp(ctx->buffer, RESULT_SIZE, t->avg, ctx->cfg);
+			return ctx->buffer;
+		case 'x': // maximum
+			format_temp(ctx->buffer, RESULT_SIZE, t->max, ctx->cfg);
+			return ctx->buffer;
+		case 'n': // minimum
+			format_temp(ctx->buffer, RESULT_SIZE, t->min, ctx->cfg);
+			return ctx->buffer;
+		case 'm': // median
+			format_temp(ctx->buffer, RESULT_SIZE, t->median, ctx->cfg);
+			return ctx->buffer;
+		case 'c': // number of readings
+			snprintf(ctx->buffer, RESULT_SIZE, "%zu", t->num);
+			return ctx->buffer;
+		case 'h': // headroom to the max (or crit) limit
+			if (t->headroom == DBL_MAX)
+			{
+				return "-";
+			}
+			format_temp(ctx->buffer, RESULT_SIZE, t->headroom, ctx->cfg);
+			return ctx->buffer;
+		case 'w': // highest limit reached
+			return t->limit == LIMIT_CRIT ? "crit" : (t->limit == LIMIT_MAX ? "max" : "ok");
+		case 'r': // throttle events since the last check
+			if (ctx->throttle->num == 0)
+			{
+				return "-";
+			}
+			snprintf(ctx->buffer, RESULT_SIZE, "%lu", ctx->throttle->delta);
+			return ctx->buffer;
+		case 'R': // throttle events since boot
+			if (ctx->throttle->num == 0)
+			{
+				return "-";
+			}
+			snprintf(ctx->buffer, RESULT_SIZE, "%lu", ctx->throttle->total);
+			return ctx->buffer;
+		case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+			if ((size_t) (c - '1') >= ctx->num_temps)
+			{
+				return NULL;
+			}
+			format_selected(ctx->buffer, &ctx->temps[c - '1'], ctx->cfg);
+			return ctx->buffer;
+		default:
+			return NULL;
+	}
+}
+
+/**
+ * Prints the current readings to stdout, according to the format string.
+ */
+void print_temps(struct config *cfg, struct temps *t, size_t num, struct throttle *th)
+{
+	struct context ctx = { .cfg = cfg, .temps = t, .num_temps = num, .throttle = th };
+	char output[OUTPUT_SIZE];
+	candy_format(cfg->format, output, OUTPUT_SIZE, candy_format_cb, &ctx);
+	fprintf(stdout, "%s\n", output);
+}
+
+/**
+ * Reads the limit of the given type (max, crit) of the feature. Limits rarely
+ * change, so they're only read once. Returns NAN if there is no such limit.
+ */
+double get_limit(sensors_chip_name const *cm, sensors_feature const *fc, sensors_subfeature_type type)
+{
+	double val;
+	sensors_subfeature const *sc = sensors_get_subfeature(cm, fc, type);
+	if (sc == NULL || (sc->flags & SENSORS_MODE_R) == 0 || 
+	    sensors_get_value(cm, sc->number, &val) != 0)
+	{
+		return NAN;
+	}
+	return val;
+}
+
+/**
+ * Finds the temperature input subfeatures of all features of the chip whose 
+ * label contains `feat` and remembers their numbers in `chip`. This is done 
+ * once, so that every check only needs to call sensors_get_value() for each 
+ * of them, instead of iterating features, labels and subfeatures again.
+ * Returns 0 on success, -1 on error.
+ */
+int load_inputs(sensors_chip_name const *cm, const char *feat, struct chip *chip)
 {
 	// Iterate over the features
 	sensors_feature const *fc = NULL; // current feature
 	int f = 0;
 
-	*t = 0.0;
-	*n = 0;
-
-	double curr = 0.0;
+	chip->name = cm;
 
 	while ((fc = sensors_get_features(cm, &f)))
 	{
@@ -183,34 +762,92 @@ double determine_temp(sensors_chip_name const *cm, const char *feat, double *t,
 		}
 
 		// Check if this is a feature the user is interested in
-		if (feat && strstr(fl, feat) != NULL)
+		int match = feat && strstr(fl, feat) != NULL;
+		free(fl);
+		fl = NULL;
+
+		if (!match)
 		{
-			// If so, we get the temperature and add it
-			curr = 0.0;
-			if (get_temp_value(cm, fc, &curr) != 0)
-			{
-				continue;
-			}
+			continue;
+		}
 
-			*t += curr;
-			++(*n);
+		// Find its temperature reading, skip if we can't read it anyway
+		sensors_subfeature const *sc = 
+			sensors_get_subfeature(cm, fc, SENSORS_SUBFEATURE_TEMP_INPUT);
+		if (sc == NULL || (sc->flags & SENSORS_MODE_R) == 0)
+		{
+			continue;
 		}
 
-		free(fl);
-		fl = NULL;
+		struct input *inputs = realloc(chip->inputs, sizeof(struct input) * (chip->num_inputs + 1));
+		if (inputs == NULL)
+		{
+			return -1;
+		}
+		chip->inputs = inputs;
+
+		struct input *input = &chip->inputs[chip->num_inputs++];
+		input->number = sc->number;
+		input->max = get_limit(cm, fc, SENSORS_SUBFEATURE_TEMP_MAX);
+		input->crit = get_limit(cm, fc, SENSORS_SUBFEATURE_TEMP_CRIT);
 	}
 
-	return *t / *n;
+	return 0;
 }
 
+void free_chip(struct chip *chip)
+{
+	free(chip->inputs);
+	*chip = (struct chip) { 0 };
+}
 
 /**
- * Prints the provided temperature value to stdout.
+ * Frees all chips and readings, then cleans up libsensors.
  */
-void print_temp(double temp, int precision, const char *unit, int space)
+void cleanup(struct chip *chips, struct temps *temps, size_t num)
 {
-	fprintf(stdout, "%.*f%s%s\n", precision, temp, 
-			space && strlen(unit) ? " " : "", unit);
+	for (size_t i = 0; i < num; ++i)
+	{
+		free_chip(&chips[i]);
+		free_temps(&temps[i]);
+	}
+	sensors_cleanup();
+}
+
+/**
+ * Reads the temperature of all previously found subfeatures of the chip into
+ * `t`, converting them to Fahrenheit if requested. Returns the number of 
+ * readings obtained.
+ */
+size_t determine_temps(struct chip *chip, struct config *cfg, struct temps *t)
+{
+	double curr = 0.0;
+	t->num = 0;
+
+	t->headroom = DBL_MAX;
+	t->limit = LIMIT_OK;
+
+	for (size_t s = 0; s < chip->num_inputs && t->num < t->size; ++s)
+	{
+		if (sensors_get_value(chip->name, chip->inputs[s].number, &curr) == 0)
+		{
+			t->vals[t->num++] = smooth_temp(t, s, 
+					cfg->imperial ? to_fahrenheit(curr) : curr, cfg->alpha);
+			check_limits(t, curr, chip->inputs[s].max, chip->inputs[s].crit);
+		}
+	}
+
+	// limits are in Celsius as well, and so is the headroom
+	if (cfg->imperial && t->headroom != DBL_MAX)
+	{
+		t->headroom *= 1.8;
+	}
+
+	if (t->num)
+	{
+		aggregate_temps(t);
+	}
+	return t->num;
 }
 
 /**
@@ -219,18 +856,37 @@ void print_temp(double temp, int precision, const char *unit, int space)
 void help(char *invocation)
 {
 	fprintf(stderr, "Usage:\n");
-     	fprintf(stderr, "\t%s [OPTIONS...] -c CHIP -f FEATURE\n", invocation);
+     	fprintf(stderr, "\t%s [OPTIONS...] -c CHIP -f FEATURE [-c CHIP -f FEATURE...]\n", invocation);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t-a Aggregation of all matching features: avg, max, min, median or each; default is avg.\n");
+	fprintf(stderr, "\t-c Chip to look for; up to 9 times, paired with -f in order.\n");
 	fprintf(stderr, "\t-e Use Fahrenheit instead of Celcius.\n");
+	fprintf(stderr, "\t-f Feature to look for; up to 9 times, paired with -c in order.\n");
+	fprintf(stderr, "\t-H Additional drop in value required in order to print again; default is 0.\n");
 	fprintf(stderr, "\t-h Print this help text and exit.\n");
 	fprintf(stderr, "\t-i Seconds between checking for a change in value; default is 1.\n");
 	fprintf(stderr, "\t-l List all chips and features, then exit.\n");
 	fprintf(stderr, "\t-m Keep running and print when there is a notable change in value.\n");
+	fprintf(stderr, "\t-o Format string, see below; default is '%%t'.\n");
 	fprintf(stderr, "\t-p Number of decimal digits in the output; default is 0.\n");
 	fprintf(stderr, "\t-s Print a space between value and unit.\n");
 	fprintf(stderr, "\t-t Required change in value in order to print again; default is 1.\n");
 	fprintf(stderr, "\t-u Include the temperature unit in the output.\n");
+	fprintf(stderr, "\t-w Smooth readings with a moving average over about this many checks.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Format specifiers:\n");
+	fprintf(stderr, "\t%%t Temperature, aggregated according to -a (first chip/feature)\n");
+	fprintf(stderr, "\t%%a Average temperature\n");
+	fprintf(stderr, "\t%%x Maximum temperature\n");
+	fprintf(stderr, "\t%%n Minimum temperature\n");
+	fprintf(stderr, "\t%%m Median temperature\n");
+	fprintf(stderr, "\t%%c Number of readings\n");
+	fprintf(stderr, "\t%%h Headroom to the closest max (or crit) limit\n");
+	fprintf(stderr, "\t%%w Highest limit reached: ok, max or crit\n");
+	fprintf(stderr, "\t%%r CPU thermal throttle events since the last check\n");
+	fprintf(stderr, "\t%%R CPU thermal throttle events since boot\n");
+	fprintf(stderr, "\t%%1 .. %%9 Like %%t, for the 1st .. 9th chip/feature pair\n");
 }
 
 /**
@@ -246,18 +902,30 @@ int main(int argc, char **argv)
 	// Get arguments, if any
 	opterr = 0;
 	int o;
-	while ((o = getopt(argc, argv, "c:ef:hi:lmp:st:u")) != -1)
+	while ((o = getopt(argc, argv, "a:c:ef:H:hi:lmo:p:st:uw:")) != -1)
 	{
 		switch (o)
 		{
+			case 'a':
+				cfg.aggr = parse_aggregation(optarg);
+				break;
 			case 'c':
-				cfg.chip = optarg;
+				if (cfg.num_chips < MAX_SELECTORS)
+				{
+					cfg.chips[cfg.num_chips++] = optarg;
+				}
 				break;
 			case 'e':
 				cfg.imperial = 1;
 				break;
 			case 'f':
-				cfg.feat = optarg;
+				if (cfg.num_feats < MAX_SELECTORS)
+				{
+					cfg.feats[cfg.num_feats++] = optarg;
+				}
+				break;
+			case 'H':
+				cfg.hysteresis = atof(optarg);
 				break;
 			case 'h':
 				help(argv[0]);
@@ -271,6 +939,9 @@ int main(int argc, char **argv)
 			case 'm':
 				cfg.monitor = 1;
 				break;
+			case 'o':
+				cfg.format = optarg;
+				break;
 			case 'p':
 				cfg.precision = atoi(optarg);
 				break;
@@ -283,12 +954,23 @@ int main(int argc, char **argv)
 			case 'u':
 				cfg.unit = 1;
 				break;
+			case 'w':
+				// same weight as a simple moving average over that window
+				cfg.alpha = 2.0 / (atoi(optarg) + 1);
+				break;
 		}
 	}
 	
 	// Prepare strings we'll need multiple times 
 	cfg.unit_str = cfg.unit ? (cfg.imperial ? UNIT_IMPERIAL : UNIT_METRIC) : "";
 
+	// Unknown aggregation mode? Print help and exit
+	if (cfg.aggr == -1)
+	{
+		help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
 	// Init sensors library
 	if (sensors_init(NULL) != 0)
 	{
@@ -305,21 +987,53 @@ int main(int argc, char **argv)
 	}
 
 	// Chip and/or feature not given? Print help and exit
-	if (cfg.chip == NULL || cfg.feat == NULL)
+	if (cfg.num_chips == 0 || cfg.num_feats == 0)
 	{
 		help(argv[0]);
 		sensors_cleanup();
 		return EXIT_SUCCESS;
 	}
-	
-	// Find the chip that matches the provided chip name
-	sensors_chip_name const *cm = find_chip(cfg.chip);
 
-	// Abort if we didn't find any matching chips
-	if (cm == NULL)
+	// Chips and features are paired up in order; if there are more of one 
+	// than the other, the last one given is used for the remaining pairs
+	size_t num = cfg.num_chips > cfg.num_feats ? cfg.num_chips : cfg.num_feats;
+	struct chip chips[MAX_SELECTORS] = { 0 };
+	struct temps temps[MAX_SELECTORS] = { 0 };
+
+	for (size_t i = 0; i < num; ++i)
 	{
-		sensors_cleanup();
-		return EXIT_FAILURE;
+		const char *chip = cfg.chips[i < cfg.num_chips ? i : cfg.num_chips - 1];
+		const char *feat = cfg.feats[i < cfg.num_feats ? i : cfg.num_feats - 1];
+
+		// Find the chip that matches the provided chip name, then the 
+		// chip's temperature inputs that match the feature name (once)
+		sensors_chip_name const *cm = find_chip(chip);
+		if (cm == NULL || load_inputs(cm, feat, &chips[i]) == -1 || 
+		    chips[i].num_inputs == 0 ||
+		    reserve_temps(&temps[i], chips[i].num_inputs) == -1)
+		{
+			cleanup(chips, temps, num);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Without a format string, all pairs are printed one after the other
+	char pairs_format[MAX_SELECTORS * 3] = { 0 };
+	size_t len = 0;
+	for (size_t i = 0; i < num && num > 1; ++i)
+	{
+		len += snprintf(pairs_format + len, sizeof(pairs_format) - len, 
+				"%s%%%zu", i ? " " : "", i + 1);
+	}
+	cfg.format = cfg.format ? cfg.format : (num > 1 ? pairs_format : DEFAULT_FORMAT);
+
+	// Throttle counters, if requested (missing ones just print as "-")
+	struct throttle throttle = { 0 };
+	cfg.cpus = DEFAULT_CPU_PATH;
+	cfg.throttle = strstr(cfg.format, "%r") || strstr(cfg.format, "%R");
+	if (cfg.throttle)
+	{
+		load_throttle(cfg.cpus, &throttle);
 	}
 
 	// If no threshold given, determine it based on the precision
@@ -328,6 +1042,12 @@ int main(int argc, char **argv)
 		cfg.threshold = DEFAULT_THRESHOLD / pow(10.0, (double) cfg.precision);
 	}
 
+	// No (or no useful) smoothing window given, don't smooth
+	if (cfg.alpha <= 0.0 || cfg.alpha > 1.0)
+	{
+		cfg.alpha = 1.0;
+	}
+
 	// If no interval given, use the default
 	if (cfg.interval == 0)
 	{
@@ -345,42 +1065,37 @@ int main(int argc, char **argv)
 	setlinebuf(stdout);
 
 	// Loop vars
-	double temp_sum = 0.0;
-	size_t temp_num = 0;
-	double temp_avg_prev  = -DBL_MAX;
-	double temp_avg_curr  =  0.0;
-	double temp_avg_delta =  0.0;
+	int changed;
 
 	do
 	{
-		// Get the current temperature (average of all found values)
-		temp_avg_curr = determine_temp(cm, cfg.feat, &temp_sum, &temp_num);
-		
-		// We didn't manage to find a temp value
-		if (temp_num <= 0)
+		changed = 0;
+		for (size_t i = 0; i < num; ++i)
 		{
-			// k thx bye :(
-			sensors_cleanup();
-			return EXIT_FAILURE;
+			// Get the current temperatures (all matching features)
+			if (determine_temps(&chips[i], &cfg, &temps[i]) == 0)
+			{
+				// We didn't manage to find a temp value
+				// k thx bye :(
+				free_throttle(&throttle);
+				cleanup(chips, temps, num);
+				return EXIT_FAILURE;
+			}
+
+			// Check if the difference is significant enough
+			changed |= temps_changed(&temps[i], cfg.aggr, cfg.threshold, cfg.hysteresis);
 		}
 
-		// Convert to Fahrenheit, if the user asked us to
-		if (cfg.imperial)
+		// Get the current throttle counters
+		if (cfg.throttle)
 		{
-			temp_avg_curr = to_fahrenheit(temp_avg_curr);
+			read_throttle(&throttle);
+			changed |= throttle_changed(&throttle);
 		}
 
-		// Figure out the difference to the previously printed value
-		temp_avg_delta = fabs(temp_avg_curr - temp_avg_prev);
-
-		// Check if the difference is significant enough
-		if (temp_avg_delta >= cfg.threshold)
+		if (changed)
 		{
-			// Print (and possibly convert to Fahrenheit first) 
-			print_temp(temp_avg_curr, cfg.precision, cfg.unit_str, cfg.space);
-
-			// Update values
-			temp_avg_prev = temp_avg_curr;
+			print_temps(&cfg, temps, num, &throttle);
 		}
 
 		// Sleep, maybe (if interval > 0)
@@ -389,6 +1104,7 @@ int main(int argc, char **argv)
 	while (cfg.monitor);
 
 	// Cleanup
-	sensors_cleanup();
+	free_throttle(&throttle);
+	cleanup(chips, temps, num);
 	return EXIT_SUCCESS;
 }
@@ -13,6 +13,11 @@ struct candy_cfg {
 	int unit : 1;          // print unit after value? ('%')
 	int precision;         // how many decimal places to print?
 	char *muted;           // string to print when sink is muted
+
+	uint32_t sink;         // index of the default sink
+	int querying : 1;      // sink info query in flight?
+	int stale : 1;         // sink changed while querying?
+	int relookup : 1;      // default sink changed while querying?
 };
 
 /**
@@ -42,19 +47,62 @@ void help(const char *invocation)
 	fprintf(stdout, "\t-w<string> Print this string instead of the volume level when the sink is muted.\n");
 }
 
+void cb_sink_info(pa_context *c, const pa_sink_info *i, int eol, void *data);
+void cb_server_info(pa_context *c, const pa_server_info *i, void *data);
+
+/**
+ * Query the info of the default sink by its index, unless a query is already 
+ * in flight, in which case another one will be made once that one is done.
+ */
+void query_sink(pa_context *c, struct candy_cfg *cfg)
+{
+	if (cfg->querying)
+	{
+		cfg->stale = 1;
+		return;
+	}
+
+	pa_operation *o = NULL;
+	o = pa_context_get_sink_info_by_index(c, cfg->sink, cb_sink_info, cfg);
+	if (o)
+	{
+		cfg->querying = 1;
+		cfg->stale = 0;
+		pa_operation_unref(o);
+	}
+}
+
 /**
  * Callback for when we receive previously queried sink information.
  * This will actually let us query the queried sink's volume, yay!
  */
 void cb_sink_info(pa_context *c, const pa_sink_info *i, int eol, void *data)
 {
-	// We're not interested in the "end of list" marker
-	if (eol == 1)
+	struct candy_cfg *cfg = data;
+
+	// End of list (or error), so the query is done; if the default sink or 
+	// the sink itself changed in the meantime, query again, once, instead of 
+	// once per change
+	if (eol != 0)
 	{
+		cfg->querying = 0;
+		if (cfg->relookup)
+		{
+			cfg->relookup = 0;
+			cfg->stale = 0;
+			pa_operation *o = NULL;
+			o = pa_context_get_server_info(c, cb_server_info, data);
+			pa_operation_unref(o);
+		}
+		else if (cfg->stale)
+		{
+			query_sink(c, cfg);
+		}
 		return;
 	}
-	
-	struct candy_cfg *cfg = data;
+
+	// Remember the sink's index, so we can tell its events from others'
+	cfg->sink = i->index;
 	
 	// Is the sink muted?
 	if (i->mute && cfg->muted)
@@ -82,14 +130,31 @@ void cb_sink_info(pa_context *c, const pa_sink_info *i, int eol, void *data)
 
 /**
  * Callback for when we receive previously queried server information.
- * This helps us find the default sink's name, so we can query it.
+ * This helps us find the default sink's name, so we can query it. The 
+ * reply will also tell us its index, which we then use from there on.
  */
 void cb_server_info(pa_context *c, const pa_server_info *i, void *data)
 {
-	// Let's query the default sink's information
+	struct candy_cfg *cfg = data;
+
+	// Only one query at a time; look the default sink up again once the 
+	// one in flight is done
+	if (cfg->querying)
+	{
+		cfg->relookup = 1;
+		return;
+	}
+
+	// Let's query the default sink's information; this counts as a query 
+	// in flight, so that sink events arriving meanwhile don't add another
 	pa_operation *o = NULL;
 	o = pa_context_get_sink_info_by_name(c, i->default_sink_name, cb_sink_info, data);
-	pa_operation_unref(o);
+	if (o)
+	{
+		cfg->querying = 1;
+		cfg->stale = 0;
+		pa_operation_unref(o);
+	}
 }
 
 /**
@@ -102,17 +167,32 @@ void cb_ctx_success(pa_context *c, int success, void *data)
 
 /**
  * Callback for when a subscribed event has occured. In our case, that's
- * a change regarding the default sink, for example volume or mute state.
+ * a change regarding the default sink, for example volume or mute state, 
+ * or a change of the server, which might mean a different default sink.
  */
 void cb_sub_event(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, void *data)
 {
-	if (t == PA_SUBSCRIPTION_EVENT_CHANGE)
+	struct candy_cfg *cfg = data;
+	pa_subscription_event_type_t facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+	pa_subscription_event_type_t type = t & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+
+	if (type != PA_SUBSCRIPTION_EVENT_CHANGE)
+	{
+		return;
+	}
+
+	if (facility == PA_SUBSCRIPTION_EVENT_SERVER)
 	{
-		// Volume and/or mute state might have changed, query server again
+		// The default sink might have changed, find it again
 		pa_operation *o = NULL;
 		o = pa_context_get_server_info(c, cb_server_info, data);
 		pa_operation_unref(o);
 	}
+	else if (facility == PA_SUBSCRIPTION_EVENT_SINK && idx == cfg->sink)
+	{
+		// Volume and/or mute state might have changed, query sink again
+		query_sink(c, cfg);
+	}
 }
 
 /**
@@ -130,8 +210,8 @@ void cb_ctx_status(pa_context *c, void *data)
 	// Ask for information about the PulseAudio server. This will enable us 
 	// to get the name/index of the default sink, which is hopefully the audio 
 	// device in use. From there, we can then actually query the volume level.
-	// We'll do this whenever the volume changes, but we also want to do it at 
-	// least once on startup - right here!
+	// We'll do this once on startup - right here! - and then again only when
+	// the server changes, as that might mean a different default sink.
 	pa_operation *o = NULL;
 	o = pa_context_get_server_info(c, cb_server_info, data);
 	pa_operation_unref(o);
@@ -142,7 +222,8 @@ void cb_ctx_status(pa_context *c, void *data)
 	{
 		// Now let's make sure we receive information about changes
 		pa_context_set_subscribe_callback(c, cb_sub_event, data);
-		o = pa_context_subscribe(c, PA_SUBSCRIPTION_MASK_SINK, cb_ctx_success, data);
+		pa_subscription_mask_t mask = PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SERVER;
+		o = pa_context_subscribe(c, mask, cb_ctx_success, data);
 		pa_operation_unref(o);
 	}
 }
@@ -166,6 +247,7 @@ void cleanup(struct candy_cfg *cfg)
 int main(int argc, char **argv)
 {
 	struct candy_cfg cfg = { 0 };
+	cfg.sink = PA_INVALID_INDEX;
 
 	opterr = 0;
 	int o;